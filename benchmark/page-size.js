@@ -0,0 +1,92 @@
+'use strict';
+// Compares write and read performance with different page sizes, using a spread of value sizes
+// (mostly small, with a long tail of larger values that need overflow pages)
+var testDirPath = new URL('./benchdata', import.meta.url).toString().slice(8);
+import fs from 'fs';
+import rimraf from 'rimraf';
+import benchmark from 'benchmark';
+
+import { open } from '../node-index.js';
+
+var total = 10000;
+var pageSizes = [0x1000, 0x4000, 0x10000];
+var values = [];
+var seed = 1;
+function random() {
+  seed = (seed * 16807) % 2147483647;
+  return seed / 2147483647;
+}
+for (let i = 0; i < total; i++) {
+  // log-uniform distribution of sizes from 64 bytes to 64KB
+  let size = Math.round(64 * Math.pow(1024, random()));
+  values.push(Buffer.alloc(size, i & 0xff));
+}
+var c = 0;
+var result;
+
+function cleanup(done) {
+  rimraf(testDirPath, function(err) {
+    if (err) {
+      return done(err);
+    }
+    fs.mkdirSync(testDirPath, { recursive: true });
+    done();
+  });
+}
+
+function openStore(pageSize) {
+  let rootStore = open(testDirPath + '/page-size-' + pageSize + '.mdb', {
+    noMemInit: true,
+    pageSize,
+  });
+  return rootStore.openDB('testing', {
+    create: true,
+    encoding: 'binary',
+    keyIsUint32: true,
+  });
+}
+
+cleanup(async function (err) {
+  if (err) {
+    throw err;
+  }
+  var suite = new benchmark.Suite();
+  for (let pageSize of pageSizes) {
+    let store = openStore(pageSize);
+    let lastPromise;
+    for (let i = 0; i < total; i++) {
+      lastPromise = store.put(i, values[i]);
+    }
+    await lastPromise;
+    suite.add('put ' + (pageSize >> 10) + 'K pages', {
+      defer: true,
+      fn(deferred) {
+        result = store.batch(() => {
+          for (let i = 0; i < 100; i++) {
+            let key = (c += 357) % total;
+            store.put(key, values[key]);
+          }
+        }).then(() => deferred.resolve());
+      }
+    });
+    suite.add('get ' + (pageSize >> 10) + 'K pages', function() {
+      result = store.getBinaryFast((c += 357) % total);
+    });
+    suite.add('getRange ' + (pageSize >> 10) + 'K pages', function() {
+      let start = (c += 357) % total;
+      for (let entry of store.getRange({ start, end: start + 10 })) {
+        result = entry;
+      }
+    });
+  }
+  suite.on('cycle', function (event) {
+    console.log(String(event.target));
+  });
+  suite.on('complete', function () {
+    for (let pageSize of pageSizes) {
+      let stats = fs.statSync(testDirPath + '/page-size-' + pageSize + '.mdb');
+      console.log((pageSize >> 10) + 'K pages: database file size ' + stats.size);
+    }
+  });
+  suite.run({ async: true });
+});
@@ -19,7 +19,10 @@
         "dependencies/libmdbx/mdbx.c++",
         "dependencies/lz4/lib/lz4.h",
         "dependencies/lz4/lib/lz4.c",
+        "dependencies/lz4/lib/lz4hc.h",
+        "dependencies/lz4/lib/lz4hc.c",
         "src/writer.cpp",
+        "src/reader.cpp",
         "src/env.cpp",
         "src/compression.cpp",
         "src/ordered-binary.cpp",
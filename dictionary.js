@@ -0,0 +1,93 @@
+// Training of LZ4 prefix dictionaries from sampled values, and the format they are stored in (under a store's
+// dictionaryKey, in the store's separate dictionaries database). This follows the approach of zstd's FASTCOVER: the samples are divided into one epoch per segment
+// of the dictionary, and from each epoch we take the segment whose (not yet covered) 8-byte sequences are most
+// frequent across all the samples.
+const SEQUENCE_LENGTH = 8;
+const SEGMENT_SIZE = 256;
+const HASH_BITS = 20;
+const MAX_DICTIONARY_SIZE = 0x10000; // LZ4 only references the last 64KB of a dictionary
+const DICTIONARIES_FORMAT = 1;
+
+export function trainFromSamples(samples, dictionarySize) {
+	dictionarySize = Math.min(dictionarySize || 0x8000, MAX_DICTIONARY_SIZE);
+	let data = Buffer.concat(samples);
+	if (data.length <= dictionarySize)
+		return data;
+	let sequenceCount = data.length - SEQUENCE_LENGTH + 1;
+	let hashes = new Uint32Array(sequenceCount);
+	let frequencies = new Uint32Array(1 << HASH_BITS);
+	for (let i = 0; i < sequenceCount; i++) {
+		let hash = (Math.imul(data.readUInt32LE(i), 0x9e3779b1) ^ Math.imul(data.readUInt32LE(i + 4), 0x85ebca77)) >>> (32 - HASH_BITS);
+		hashes[i] = hash;
+		frequencies[hash]++;
+	}
+	let epochs = Math.max(1, Math.min(dictionarySize / SEGMENT_SIZE, sequenceCount / SEGMENT_SIZE) >> 0);
+	let epochSize = (sequenceCount / epochs) >> 0;
+	let segmentSequences = SEGMENT_SIZE - SEQUENCE_LENGTH + 1;
+	let inSegment = new Uint16Array(1 << HASH_BITS);
+	let dictionary = Buffer.alloc(dictionarySize);
+	// the first (best) segments go at the end of the dictionary, where they can be referenced with the shortest offsets
+	let dictionaryStart = dictionarySize;
+	for (let epoch = 0; epoch < epochs && dictionaryStart >= SEGMENT_SIZE; epoch++) {
+		let start = epoch * epochSize;
+		let end = Math.min(start + epochSize, sequenceCount - segmentSequences);
+		let score = 0, bestScore = 0, bestStart = -1;
+		// slide a segment through the epoch, counting each distinct sequence in the segment once
+		for (let i = start; i < end + segmentSequences; i++) {
+			if (inSegment[hashes[i]]++ == 0)
+				score += frequencies[hashes[i]];
+			if (i - start >= segmentSequences) {
+				let leaving = hashes[i - segmentSequences];
+				if (--inSegment[leaving] == 0)
+					score -= frequencies[leaving];
+			}
+			if (i - start >= segmentSequences - 1 && score > bestScore) {
+				bestScore = score;
+				bestStart = i - segmentSequences + 1;
+			}
+		}
+		for (let i = Math.max(start, end); i < end + segmentSequences; i++)
+			inSegment[hashes[i]] = 0;
+		if (bestStart == -1)
+			continue;
+		// the sequences in the chosen segment are now covered, so don't count them again
+		for (let i = bestStart; i < bestStart + segmentSequences; i++)
+			frequencies[hashes[i]] = 0;
+		dictionaryStart -= SEGMENT_SIZE;
+		data.copy(dictionary, dictionaryStart, bestStart, bestStart + SEGMENT_SIZE);
+	}
+	return dictionary.subarray(dictionaryStart);
+}
+
+// The stored record is a format byte, followed by each dictionary as a version byte, three reserved bytes, a 32-bit
+// length, and the dictionary bytes
+export function encodeDictionaries(dictionaries) {
+	let size = 1;
+	for (let { dictionary } of dictionaries)
+		size += 8 + dictionary.length;
+	let record = Buffer.alloc(size);
+	record[0] = DICTIONARIES_FORMAT;
+	let position = 1;
+	for (let { version, dictionary } of dictionaries) {
+		record[position] = version;
+		record.writeUInt32LE(dictionary.length, position + 4);
+		record.set(dictionary, position + 8);
+		position += 8 + dictionary.length;
+	}
+	return record;
+}
+
+export function decodeDictionaries(record) {
+	let dictionaries = [];
+	if (!record || record[0] != DICTIONARIES_FORMAT)
+		return dictionaries;
+	for (let position = 1; position < record.length;) {
+		let length = record.readUInt32LE(position + 4);
+		dictionaries.push({
+			version: record[position],
+			dictionary: Buffer.from(record.subarray(position + 8, position + 8 + length)),
+		});
+		position += 8 + length;
+	}
+	return dictionaries;
+}
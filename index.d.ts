@@ -19,6 +19,29 @@ declare namespace lmdb {
 			version?: number
 		} | undefined
 
+		/**
+		* Get the values for the given keys, in the same order as the keys. The keys are looked up in sorted
+		* order with a single cursor, which is faster than separate gets for large sets of keys.
+		* @param ids The keys for the entries
+		**/
+		getMany(ids: K[], callback?: (error: any, values: (V | undefined)[]) => any): Promise<(V | undefined)[]>
+		/**
+		* Check if entries exist for the given keys, returning an array of booleans in the same order as the keys
+		* @param ids The keys of the entries to check
+		**/
+		doesExistMany(ids: K[]): boolean[]
+		/**
+		* Get the value stored by given id/key, performing the read on a reader thread, so that page faults
+		* from reading data that isn't in memory don't block the main thread
+		* @param id The key for the entry
+		**/
+		getAsync(id: K): Promise<V | undefined>
+		/**
+		* Get the values for the given keys on a reader thread, in the same order as the keys
+		* @param ids The keys for the entries
+		**/
+		getManyAsync(ids: K[]): Promise<(V | undefined)[]>
+
 		/**
 		* Get the value stored by given id/key in binary format, as a Buffer
 		* @param id The key for the entry
@@ -99,6 +122,38 @@ declare namespace lmdb {
 		**/
 		removeSync(id: K, valueToRemove: V): boolean
 		/**
+		* Atomically add to the number stored at the key (as an 8 byte little-endian double, or int64 for a bigint), on the write thread
+		* @param id The key for the entry
+		* @param amount The amount to add (the entry is set to this if it doesn't exist)
+		* @param version The version number to assign to this entry
+		**/
+		add(id: K, amount: number | bigint, version?: number): Promise<boolean>
+		/**
+		* Atomically set the number stored at the key to the maximum of it and the provided number
+		**/
+		max(id: K, number: number | bigint, version?: number): Promise<boolean>
+		/**
+		* Atomically set the number stored at the key to the minimum of it and the provided number
+		**/
+		min(id: K, number: number | bigint, version?: number): Promise<boolean>
+		/**
+		* Atomically append bytes to the end of the stored (binary) value
+		**/
+		append(id: K, bytes: Buffer | string, version?: number): Promise<boolean>
+		/**
+		* Atomically overwrite the bytes of the stored (binary) value starting at the offset, extending it if necessary
+		**/
+		patch(id: K, offset: number, bytes: Buffer | string, version?: number): Promise<boolean>
+		/**
+		* Atomically store the value and return the previous value at the key
+		**/
+		getAndSet(id: K, value: V, version?: number): Promise<V | undefined>
+		/**
+		* Remove all the entries with keys from start (inclusive) to end (exclusive) with a single write instruction
+		* @param options The range to remove, and the number of entries to delete per transaction (chunkSize), if it should be chunked
+		**/
+		removeRange(options: RemoveRangeOptions): Promise<boolean>
+		/**
 		* Get all the values for the given key (for dupsort databases)
 		* existing version
 		* @param key The key for the entry to remove
@@ -130,6 +185,21 @@ declare namespace lmdb {
 		**/
 		getRange(options: RangeOptions): ArrayLikeIterable<{ key: K, value: V, version?: number }>
 		/**
+		* Scan the given range in parallel, with each partition of the range scanned by a separate thread on a
+		* consistent snapshot. Entries are passed to the callback in blocks, in ascending order within each partition
+		* (reverse is not supported).
+		* @param options The options for the range, including the number of partitions
+		* @param onEntries Called with each block of entries (or keys, if values are not included) and its partition
+		**/
+		getRangeParallel(options: RangeOptions, onEntries: (entries: any[], partition: number) => void): Promise<void>
+		/**
+		* Split the given range into partitions with roughly the same number of entries, returning range options for
+		* each partition (which can be scanned separately, for example in worker threads). A reverse range is split into
+		* reverse partitions, from the start of the range.
+		* @param options The options for the range, including the number of partitions
+		**/
+		getRangePartitions(options: RangeOptions): RangeOptions[]
+		/**
 		* Get the count of all the entries for the given range
 		* existing version
 		* @param options The options for the range/iterator
@@ -204,7 +274,7 @@ declare namespace lmdb {
 		/**
 		* Delete this database/store (asynchronously).
 		**/
-		drop(): Promise<void>
+		drop(options?: ChunkOptions): Promise<void>
 		/**
 		* Synchronously delete this database/store.
 		**/
@@ -216,7 +286,7 @@ declare namespace lmdb {
 		/**
 		* Asynchronously clear all the entries from this database/store.
 		**/
-		clearAsync(): Promise<void>
+		clearAsync(options?: ChunkOptions): Promise<void>
 		/**
 		* Synchronously clear all the entries from this database/store.
 		**/
@@ -226,26 +296,90 @@ declare namespace lmdb {
 		**/
 		readerCheck(): number
 		/**
-		* Returns a string that describes all the current reader locks, useful for debugging if reader locks aren't being removed.
+		* Returns the entries of the reader lock table, useful for finding readers that hold old snapshots (a txnId of 0 is an idle reader).
 		**/
-		readerList(): string
+		readerList(): ReaderInfo[]
 		/**
 		* Returns statistics about the current database
 		**/
 		getStats(): {}
 		/**
+		* Train a compression dictionary from a sample of the values in this database, and store it as the newest version under the dictionaryKey. Resolves to the version of the new dictionary, which is used to compress any new values.
+		**/
+		trainDictionary(options?: DictionaryOptions): Promise<number>
+		/**
+		* Rewrite the entries that were compressed with an older dictionary or a different codec, so they use the current ones. Resolves to the number of entries that were rewritten.
+		**/
+		recompress(options?: { batchSize?: number }): Promise<number>
+		/**
+		* Load any dictionaries that have been trained (by another process) since this database was opened
+		**/
+		loadDictionaries(): void
+		/**
 		* Explicitly force the read transaction to reset to the latest snapshot/version of the database
 		**/
 		resetReadTxn(): void
 		/**
-		* Make a snapshot copy of the current database at the indicated path
+		* Pin the current snapshot of the database, which is held across event turns until it is released
+		**/
+		snapshot(): Snapshot<V, K>
+		/**
+		* Make a snapshot copy of the current database at the indicated path (which must not exist yet), or write it to the given file descriptor (which may be a pipe)
 		**/
-		backup(path: string): Promise<void>
+		backup(pathOrFd: string | number, options?: boolean | BackupOptions): Promise<void>
+		/**
+		* Flush all committed data to disk. Concurrent calls are combined into a single flush. Resolves to the id of the last transaction that is durable.
+		**/
+		sync(): Promise<number>
 		/**
 		* Close the current database.
 		**/
 		close(): void
 	}
+	interface ReaderInfo {
+		slot: number
+		pid: number
+		thread: number
+		txnId: number
+		/** The number of commits since the reader's snapshot **/
+		lag: number
+		usedSize: number
+		/** The size (in bytes) of the pages that can't be reused because of this reader **/
+		retainedSize: number
+	}
+	interface SlowReader {
+		pid: number
+		thread: number
+		txnId: number
+		lag: number
+		retainedSize: number
+	}
+	interface SnapshotInfo {
+		/** The id of the transaction that the snapshot reads **/
+		txnId: number
+		/** The number of commits since the snapshot was taken **/
+		readerLag: number
+		/** The size (in bytes) of the pages that can't be reused while the snapshot is held **/
+		retainedSize: number
+		/** The time since the snapshot was taken, in milliseconds **/
+		age: number
+	}
+	class Snapshot<V = any, K extends Key = Key> {
+		get(id: K): V | undefined
+		getEntry(id: K): { value: V, version?: number } | undefined
+		getBinary(id: K): Buffer | undefined
+		doesExist(key: K, valueOrVersion?: number | any): boolean
+		getMany(ids: K[]): (V | undefined)[]
+		getRange(options?: RangeOptions): ArrayLikeIterable<{ key: K, value: V, version?: number }>
+		getKeys(options?: RangeOptions): ArrayLikeIterable<K>
+		getValues(key: K, options?: RangeOptions): ArrayLikeIterable<V>
+		getCount(options?: RangeOptions): number
+		info(): SnapshotInfo
+		/**
+		* Release the snapshot (its read transaction is reused for later snapshots)
+		**/
+		release(): void
+	}
 	/* A special value that can be returned from a transaction to indicate that the transaction should be aborted */
 	export const ABORT = 10000000000000
 	class RootDatabase<V = any, K extends Key = Key> extends Database<V, K> {
@@ -267,6 +401,8 @@ declare namespace lmdb {
 		compression?: boolean | CompressionOptions
 		encoding?: 'msgpack' | 'json' | 'string' | 'binary' | 'ordered-binary'
 		sharedStructuresKey?: Key
+		/** Enables trained compression dictionaries for this database, stored under this key in a separate database **/
+		dictionaryKey?: Key
 		useVersions?: boolean
 		keyEncoding?: 'uint32' | 'binary' | 'ordered-binary'
 		dupSort?: boolean
@@ -280,6 +416,9 @@ declare namespace lmdb {
 		asyncTransactionOrder?: 'after' | 'before' | 'strict'
 		mapSize?: number
 		pageSize?: number
+		minSize?: number
+		growthStep?: number
+		shrinkThreshold?: number
 		remapChunks?: boolean
 		/** This provides a small performance boost (when not using useWritemap) for writes, by skipping zero'ing out malloc'ed data, but can leave application data in unused portions of the database. This is recommended unless there are concerns of database files being accessible. */
 		noMemInit?: boolean
@@ -287,6 +426,20 @@ declare namespace lmdb {
 		useWritemap?: boolean
 		noSubdir?: boolean
 		noSync?: boolean
+		/** Commit transactions without waiting for the disk, and flush them afterwards on a separate thread. */
+		overlappingSync?: boolean
+		/** Resolve writes when they are committed, with a separate flushed promise for when they are durable. */
+		separateFlushed?: boolean
+		/** Only apply the last plain put or remove of a key within an event turn batch. */
+		coalesceWrites?: boolean
+		/** What to do when a reader prevents pages from being reused: log it, kick it (clear its reader slot), or notify 'slowreader' listeners */
+		slowReaderPolicy?: 'log' | 'kick' | 'notify'
+		/** Only apply the slow reader policy to readers that are at least this many commits behind */
+		slowReaderLag?: number
+		/** With safeNoSync or overlappingSync, automatically sync once this many bytes have been written without syncing. */
+		syncBytes?: number
+		/** With safeNoSync or overlappingSync, automatically sync once this many milliseconds have passed since the last sync. */
+		syncPeriod?: number
 		noMetaSync?: boolean
 		readOnly?: boolean
 		mapAsync?: boolean
@@ -296,9 +449,32 @@ declare namespace lmdb {
 	interface RootDatabaseOptionsWithPath extends RootDatabaseOptions {
 		path: string
 	}
+	interface BackupOptions {
+		/** Omit free pages and renumber the pages in the copy */
+		compact?: boolean
+		/** Make the copy's size dynamic, rather than fixed */
+		forceDynamicSize?: boolean
+		/** Limit the rate the copy is written at, so it doesn't starve other I/O */
+		bytesPerSecond?: number
+		/** Called with the number of bytes that have been copied so far */
+		progress?: (bytesCopied: number) => void
+	}
+	interface DictionaryOptions {
+		/** The number of values to sample (defaults to 1000) **/
+		samples?: number
+		/** The size of the dictionary, up to 65536 (defaults to 32768) **/
+		dictionarySize?: number
+	}
 	interface CompressionOptions {
 		threshold?: number
 		dictionary?: Buffer
+		threads?: number
+		/** The codec that values are compressed with (defaults to 'lz4') **/
+		codec?: 'lz4' | 'lz4hc'
+		/** The compression level of the lz4hc codec, from 3 to 12 (defaults to 9) **/
+		level?: number
+		/** Maximum number of bytes used to cache decompressed values of frequently read entries **/
+		decompressedCacheSize?: number
 	}
 	interface RangeOptions {
 		/** Starting key for a range **/
@@ -315,6 +491,20 @@ declare namespace lmdb {
 		offset?: number
 		/** Use a snapshot of the database from when the iterator started **/
 		snapshot?: boolean
+		/** For counts, quickly estimate the count from the structure of the database, rather than counting each entry **/
+		estimate?: boolean
+		/** For parallel scans, the number of partitions (defaults to the number of CPUs) **/
+		partitions?: number
+	}
+	interface ChunkOptions {
+		/** Commit and start a new transaction after deleting this many entries, instead of deleting in one transaction **/
+		chunkSize?: number
+	}
+	interface RemoveRangeOptions extends ChunkOptions {
+		/** Starting key for the range to remove (inclusive), defaults to the first key **/
+		start?: Key
+		/** Ending key for the range to remove (exclusive), defaults to the end of the database **/
+		end?: Key
 	}
 	interface PutOptions {
 		/* Append to the database using MDB_APPEND, which can be faster */
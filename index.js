@@ -5,6 +5,7 @@ import { CachingStore, setGetLastVersion } from './caching.js';
 import { addReadMethods, makeReusableBuffer } from './read.js';
 import { addWriteMethods } from './write.js';
 import { applyKeyHandling } from './keys.js';
+import { decodeDictionaries } from './dictionary.js';
 import { Encoder as MsgpackrEncoder } from 'msgpackr';
 setGetLastVersion(getLastVersion);
 let keyBytes, keyBytesView;
@@ -61,29 +62,13 @@ export function open(path, options) {
 	if (!fs.existsSync(options.noSubdir ? dirname(path) : path))
 		fs.mkdirSync(options.noSubdir ? dirname(path) : path, { recursive: true });
 	if (options.compression) {
-		let setDefault;
 		if (options.compression == true) {
 			if (defaultCompression)
 				options.compression = defaultCompression;
-			else {
-				let compressionOptions = {
-					threshold: 1000,
-					dictionary: fs.readFileSync(new URL('./dict/dict.txt',
-						import.meta.url.replace(/dist[\\\/]index.cjs$/, ''))),
-					getValueBytes: makeReusableBuffer(0),
-				};
-				defaultCompression = options.compression = new Compression(compressionOptions);
-				Object.assign(defaultCompression, compressionOptions);
-			}
-		} else {
-			let compressionOptions = Object.assign({
-				threshold: 1000,
-				dictionary: fs.readFileSync(new URL('./dict/dict.txt', import.meta.url.replace(/dist[\\\/]index.cjs$/, ''))),
-				getValueBytes: makeReusableBuffer(0),
-			}, options.compression);
-			options.compression = new Compression(compressionOptions);
-			Object.assign(options.compression, compressionOptions);
-		}
+			else
+				defaultCompression = options.compression = makeCompression({});
+		} else
+			options.compression = makeCompression(options.compression);
 	}
 
 	let maxKeySize = env.open(options);
@@ -106,12 +91,15 @@ export function open(path, options) {
 			if (dbOptions.compression instanceof Compression) {
 				// do nothing, already compression object
 			} else if (dbOptions.compression && typeof dbOptions.compression == 'object')
-				dbOptions.compression = new Compression(Object.assign({
-					threshold: 1000,
-					dictionary: fs.readFileSync(require.resolve('./dict/dict.txt')),
-				}), dbOptions.compression);
+				dbOptions.compression = makeCompression(dbOptions.compression);
 			else if (options.compression && dbOptions.compression !== false) 
 				dbOptions.compression = options.compression; // use the parent compression if available
+			if (dbOptions.dictionaryKey !== undefined && dbOptions.compression &&
+					(dbOptions.compression == options.compression || dbOptions.compression == defaultCompression)) {
+				// trained dictionaries belong to this database, so it needs its own compression instance
+				let { threshold, dictionary, decompressedCacheSize } = dbOptions.compression;
+				dbOptions.compression = makeCompression({ threshold, dictionary, decompressedCacheSize });
+			}
 
 			if (dbOptions.dupSort && (dbOptions.useVersions || dbOptions.cache)) {
 				throw new Error('The dupSort flag can not be combined with versions or caching');
@@ -156,6 +144,12 @@ export function open(path, options) {
 			}
 			this.maxKeySize = maxKeySize;
 			applyKeyHandling(this);
+			if (this.dictionaryKey !== undefined && this.compression) {
+				// the dictionaries are stored in their own (uncompressed) database, so they aren't in this database's
+				// ranges and counts
+				this.dictionaryStore = this.openDB((dbName || '') + ':dictionaries', { compression: false, encoding: 'binary' });
+				this.loadDictionaries();
+			}
 			allDbs.set(dbName ? name + '-' + dbName : name, this);
 			stores.push(this);
 		}
@@ -220,8 +214,10 @@ export function open(path, options) {
 				return transactionResults[index + 1];
 			});
 		}
-		backup(path) {
-			return new Promise((resolve, reject) => env.copy(path, false, (error) => {
+		backup(pathOrFd, options) {
+			if (typeof options != 'object')
+				options = { compact: Boolean(options) };
+			return new Promise((resolve, reject) => env.copy(pathOrFd, options, (error) => {
 				if (error) {
 					reject(error);
 				} else {
@@ -233,11 +229,14 @@ export function open(path, options) {
 			return this.status == 'open';
 		}
 		sync(callback) {
-			return env.sync(callback || function(error) {
-				if (error) {
-					console.error(error);
-				}
-			});
+			if (callback)
+				return env.sync(callback);
+			return new Promise((resolve, reject) => env.sync((error, txnId) => {
+				if (error)
+					reject(error);
+				else
+					resolve(txnId);
+			}));
 		}
 		deleteDB() {
 			console.warn('deleteDB() is deprecated, use drop or dropSync instead');
@@ -269,7 +268,22 @@ export function open(path, options) {
 			return env.readerCheck();
 		}
 		readerList() {
-			return env.readerList().join('');
+			return env.readerList();
+		}
+		loadDictionaries() {
+			let lastVersion;
+			if (this.useVersions)
+				lastVersion = getLastVersion();
+			let dictionaries = decodeDictionaries(this.dictionaryStore.getBinary(this.dictionaryKey));
+			if (this.useVersions)
+				setLastVersion(lastVersion);
+			let compression = this.compression;
+			for (let { version, dictionary } of dictionaries) {
+				compression.addDictionary(version, dictionary);
+				if (version > (compression.dictionaryVersion || 0))
+					compression.dictionaryVersion = version;
+			}
+			return dictionaries;
 		}
 		setupSharedStructures() {
 			const getStructures = () => {
@@ -301,7 +315,7 @@ export function open(path, options) {
 	const removeSync = LMDBXStore.prototype.removeSync;
 	addReadMethods(LMDBXStore, { env, maxKeySize, keyBytes, keyBytesView, getLastVersion });
 	addWriteMethods(LMDBXStore, { env, maxKeySize, fixedBuffer: keyBytes,
-		resetReadTxn: LMDBXStore.prototype.resetReadTxn, ...options });
+		resetReadTxn: LMDBXStore.prototype.resetReadTxn, getLastVersion, ...options });
 	LMDBXStore.prototype.supports = {
 		permanence: true,
 		bufferKeys: true,
@@ -318,6 +332,16 @@ export function open(path, options) {
 }
 
 
+function makeCompression(compressionOptions) {
+	compressionOptions = Object.assign({
+		threshold: 1000,
+		dictionary: fs.readFileSync(new URL('./dict/dict.txt', import.meta.url.replace(/dist[\\\/]index.cjs$/, ''))),
+	}, compressionOptions, {
+		getValueBytes: makeReusableBuffer(0),
+	});
+	let compression = new Compression(compressionOptions);
+	return Object.assign(compression, compressionOptions);
+}
 export function getLastEntrySize() {
 	return lastSize;
 }
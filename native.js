@@ -1,4 +1,4 @@
-export let Env, Compression, Cursor, getAddress, getAddressShared, setGlobalBuffer, require, arch, fs;
+export let Env, Compression, Cursor, getAddress, getAddressShared, setGlobalBuffer, require, arch, fs, cpus;
 export function setNativeFunctions(nativeInterface) {
 	Env = nativeInterface.Env;
 	Compression = nativeInterface.Compression;
@@ -9,4 +9,5 @@ export function setNativeFunctions(nativeInterface) {
     require = nativeInterface.require;
     arch = nativeInterface.arch;
     fs = nativeInterface.fs;
+    cpus = nativeInterface.cpus;
 }
@@ -4,7 +4,7 @@ import { fileURLToPath } from 'url';
 import { dirname } from 'path';
 import { setNativeFunctions } from './native.js';
 import fs from 'fs';
-import { arch } from 'os';
+import { arch, cpus } from 'os';
 let nativeFunctions, dirName = dirname(fileURLToPath(import.meta.url)).replace(/dist$/, '');
 try {
 	nativeFunctions = require('node-gyp-build')(dirName);
@@ -26,6 +26,7 @@ try {
 }
 nativeFunctions.require = require;
 nativeFunctions.arch = arch;
+nativeFunctions.cpus = cpus;
 nativeFunctions.fs = fs;
 setNativeFunctions(nativeFunctions);
 export { toBufferKey as keyValueToBuffer, compareKeys, compareKeys as compareKey, fromBufferKey as bufferToKeyValue } from 'ordered-binary/index.js';
@@ -1,5 +1,5 @@
 import { ArrayLikeIterable }  from './util/ArrayLikeIterable.js';
-import { getAddress, Cursor, setGlobalBuffer }  from './native.js';
+import { getAddress, Cursor, setGlobalBuffer, cpus }  from './native.js';
 import { saveKey }  from './keys.js';
 import { writeKey }  from 'ordered-binary/index.js';
 import { binaryBuffer } from './write.js';
@@ -7,12 +7,20 @@ const ITERATOR_DONE = { done: true, value: undefined };
 const Uint8ArraySlice = Uint8Array.prototype.slice;
 let getValueBytes = makeReusableBuffer(0);
 let lastSize;
+const GET_MANY_EXISTS_ONLY = 2;
+let getManyKeys = growBuffer(null, 0x1000);
+const INITIAL_BATCH_SIZE = 16;
+const MAX_BATCH_SIZE = 4096;
+const MAX_POOLED_SNAPSHOTS = 8;
+const SNAPSHOT_IN_USE = {}; // stands in for the renewal timer while a snapshot's txn is the read txn
+let iterateBuffer = growBuffer(null, 0x8000);
+let getManyResults = growBuffer(null, 0x1000);
 const START_ADDRESS_POSITION = 8140;
 
 export function addReadMethods(LMDBStore, {
 	maxKeySize, env, keyBytes, keyBytesView, getLastVersion
 }) {
-	let readTxn, readTxnRenewed;
+	let readTxn, readTxnRenewed, readTxnKept;
 	let renewId = 1;
 	Object.assign(LMDBStore.prototype, {
 		getString(id) {
@@ -216,6 +224,8 @@ export function addReadMethods(LMDBStore, {
 				let store = this;
 				if (options.onlyCount) {
 					flags |= 0x1000;
+					if (options.estimate)
+						flags |= 0x8000;
 					let count = position(options.offset);
 					finishCursor();
 					return count;
@@ -266,9 +276,76 @@ export function addReadMethods(LMDBStore, {
 						}
 					}
 				}
+				// after the first entry, iterate in batches, so each native call returns many entries (unless the cursor
+				// moves to the latest snapshot between entries, which requires repositioning after each one)
+				let useBatches = snapshot !== false;
+				let batchSize = INITIAL_BATCH_SIZE;
+				let batchLength = 0, batchIndex = 0;
+				let batchKeys = [], batchValues = [], batchVersions = [];
+				let batchHeaderSize = includeValues && store.useVersions ? 16 : 8;
+				function readBatch(maxCount) {
+					let batchCount = cursor.iterateBatch(iterateBuffer, maxCount);
+					if (batchCount === 0xffffffff) { // the next entry doesn't fit
+						iterateBuffer = growBuffer(null, iterateBuffer.dataView.getUint32(0, true));
+						batchCount = cursor.iterateBatch(iterateBuffer, maxCount);
+					}
+					// decode the whole batch now, since the buffer is shared with other iterators
+					decodeEntries(store, iterateBuffer, batchCount, batchHeaderSize, includeValues, !valuesForKey,
+						batchKeys, batchValues, batchVersions);
+					return batchCount;
+				}
+				function entryResult(value, version) {
+					if (includeValues) {
+						if (includeVersions)
+							return {
+								value: {
+									key: currentKey,
+									value,
+									version
+								}
+							};
+						else if (valuesForKey)
+							return {
+								value
+							};
+						else
+							return {
+								value: {
+									key: currentKey,
+									value,
+								}
+							};
+					} else if (includeVersions) {
+						return {
+							value: {
+								key: currentKey,
+								version
+							}
+						};
+					} else {
+						return {
+							value: currentKey
+						};
+					}
+				}
 				return {
 					next() {
 						let keySize, lastSize;
+						if (count > 0 && useBatches) {
+							if (batchIndex >= batchLength) {
+								if (count >= limit || !(batchLength = readBatch(Math.min(batchSize, (limit || Infinity) - count)))) {
+									finishCursor();
+									return ITERATOR_DONE;
+								}
+								batchIndex = 0;
+								batchSize = Math.min(batchSize * 4, MAX_BATCH_SIZE);
+							}
+							count++;
+							let index = batchIndex++;
+							if (!valuesForKey)
+								currentKey = batchKeys[index];
+							return entryResult(batchValues[index], batchVersions[index]);
+						}
 						if (cursorRenewId && cursorRenewId != renewId) {
 							resetCursor();
 							keySize = position(0);
@@ -284,8 +361,8 @@ export function addReadMethods(LMDBStore, {
 						}
 						if (!valuesForKey || snapshot === false)
 							currentKey = store.readKey(keyBytes, 32, keySize + 32);
+						let value;
 						if (includeValues) {
-							let value;
 							lastSize = keyBytesView.getUint32(0, true);
 							let bytes = compression ? compression.getValueBytes : getValueBytes;
 							if (lastSize > bytes.maxLength) {
@@ -302,37 +379,8 @@ export function addReadMethods(LMDBStore, {
 								if (store.encoding == 'json' && value)
 									value = JSON.parse(value);
 							}
-							if (includeVersions)
-								return {
-									value: {
-										key: currentKey,
-										value,
-										version: getLastVersion()
-									}
-								};
- 							else if (valuesForKey)
-								return {
-									value
-								};
-							else
-								return {
-									value: {
-										key: currentKey,
-										value,
-									}
-								};
-						} else if (includeVersions) {
-							return {
-								value: {
-									key: currentKey,
-									version: getLastVersion()
-								}
-							};
-						} else {
-							return {
-								value: currentKey
-							};
 						}
+						return entryResult(value, includeVersions ? getLastVersion() : undefined);
 					},
 					return() {
 						finishCursor();
@@ -347,13 +395,154 @@ export function addReadMethods(LMDBStore, {
 			return iterable;
 		},
 		getMany(keys, callback) {
-			let results = new Array(keys.length);
-			for (let i = 0, l = keys.length; i < l; i++) {
-				results[i] = get.call(this, keys[i]);
-			}
+			let results = this._getMany(keys, false);
 			if (callback)
 				callback(null, results);
-			return Promise.resolve(results); // we may eventually make this a true async operation
+			return Promise.resolve(results); // getManyAsync performs the reads off the main thread
+		},
+		doesExistMany(keys) {
+			return this._getMany(keys, true);
+		},
+		getAsync(id) {
+			return this.getManyAsync([id]).then((values) => values[0]);
+		},
+		getManyAsync(keys) {
+			let count = keys.length;
+			let keyBlockSize = this._writeGetManyKeys(keys);
+			return new Promise((resolve, reject) => {
+				// the keys are copied by the native side, and the reads are performed on a reader thread
+				this.db.getManyAsync(getManyKeys, keyBlockSize, count, 0, (error, results) => {
+					if (error)
+						return reject(error);
+					try {
+						resolve(this._decodeGetMany(results, count, false));
+					} catch(error) {
+						reject(error);
+					}
+				});
+			});
+		},
+		_getMany(keys, existsOnly) {
+			let count = keys.length;
+			this._writeGetManyKeys(keys);
+			let flags = existsOnly ? GET_MANY_EXISTS_ONLY : 0;
+			(env.writeTxn || (readTxnRenewed ? readTxn : renewReadTxn()));
+			let size = this.db.getMany(getManyKeys, count, getManyResults, flags);
+			while (size < 0 || size > getManyResults.length) {
+				if (size < 0) // a compressed value needs a larger decompression buffer
+					this._allocateGetBuffer(-size);
+				else
+					getManyResults = growBuffer(getManyResults, size);
+				size = this.db.getMany(getManyKeys, count, getManyResults, flags);
+			}
+			if (existsOnly) {
+				let results = new Array(count);
+				for (let i = 0; i < count; i++)
+					results[i] = getManyResults[i] === 1;
+				return results;
+			}
+			return this._decodeGetMany(getManyResults, count, true);
+		},
+		_writeGetManyKeys(keys, openEnded) {
+			// pack the keys into a block of size prefixed keys, so they can all be retrieved in one native call
+			let position = 0;
+			for (let i = 0, l = keys.length; i < l; i++) {
+				if (position + maxKeySize + 8 > getManyKeys.length)
+					getManyKeys = growBuffer(getManyKeys, position + maxKeySize + 8);
+				let key = keys[i];
+				// an open ended bound is written as an empty key
+				let end = openEnded && key === undefined ? position + 4 : this.writeKey(key, getManyKeys, position + 4);
+				if (end == position + 4 && !openEnded)
+					throw new Error('Zero length key is not allowed in LMDB');
+				getManyKeys.dataView.setUint32(position, end - position - 4, true);
+				position = (end + 3) & ~3;
+			}
+			return position;
+		},
+		getRangePartitions(options) {
+			if (!options)
+				options = {};
+			let bounds;
+			if (options.reverse) {
+				// split the ascending range, and then go through it from the end
+				bounds = [options.end, ...this._getPartitionSplits({ start: options.end, end: options.start,
+					partitions: options.partitions }), options.start].reverse();
+			} else
+				bounds = [options.start, ...this._getPartitionSplits(options), options.end];
+			let partitions = [];
+			for (let i = 0; i < bounds.length - 1; i++)
+				partitions.push(Object.assign({}, options, { start: bounds[i], end: bounds[i + 1] }));
+			return partitions;
+		},
+		getRangeParallel(options, onEntries) {
+			if (!options)
+				options = {};
+			if (options.reverse)
+				throw new Error('Reverse order is not supported for parallel scans, the partitions are scanned in ascending order');
+			let bounds = [options.start, ...this._getPartitionSplits(options), options.end];
+			let partitions = bounds.length - 1;
+			let boundsSize = this._writeGetManyKeys(bounds, true);
+			let includeValues = options.values !== false;
+			let includeVersions = options.versions;
+			let headerSize = includeValues && this.useVersions ? 16 : 8;
+			return new Promise((resolve, reject) => {
+				let remaining = partitions;
+				let failed;
+				this.db.scanParallel(getManyKeys, boundsSize, partitions, includeValues, (error, partition, buffer, count, done) => {
+					if (failed)
+						return;
+					try {
+						if (error)
+							throw error;
+						if (count > 0) {
+							let keys = [], values = [], versions = [];
+							decodeEntries(this, buffer, count, headerSize, includeValues, true, keys, values, versions);
+							let entries = includeValues ? new Array(count) : keys;
+							if (includeValues) {
+								for (let i = 0; i < count; i++)
+									entries[i] = includeVersions ?
+										{ key: keys[i], value: values[i], version: versions[i] } :
+										{ key: keys[i], value: values[i] };
+							}
+							onEntries(entries, partition);
+						}
+						if (done && --remaining == 0)
+							resolve();
+					} catch(error) {
+						failed = true;
+						reject(error);
+					}
+				});
+			});
+		},
+		_getPartitionSplits(options) {
+			this._writeGetManyKeys([options.start, options.end], true);
+			(env.writeTxn || (readTxnRenewed ? readTxn : renewReadTxn()));
+			return this.db.getPartitions(getManyKeys, options.partitions || cpus().length)
+				.map((split) => this.readKey(split, 0, split.length));
+		},
+		_decodeGetMany(buffer, count, reusedBuffer) {
+			let results = new Array(count);
+			let dataView = buffer.dataView || new DataView(buffer.buffer, buffer.byteOffset, buffer.length);
+			for (let i = 0; i < count; i++) {
+				let start = dataView.getUint32(i << 3, true);
+				if (start === 0xffffffff)
+					continue;
+				let end = start + dataView.getUint32((i << 3) + 4, true);
+				let value;
+				if (this.decoder)
+					value = this.decoder.decode(buffer.subarray(start, end));
+				else if (this.encoding == 'binary')
+					// a reused buffer will be overwritten by the next getMany, so the value must be copied
+					value = reusedBuffer ? Uint8ArraySlice.call(buffer, start, end) : buffer.subarray(start, end);
+				else {
+					value = buffer.toString('utf8', start, end);
+					if (this.encoding == 'json')
+						value = JSON.parse(value);
+				}
+				results[i] = value;
+			}
+			return results;
 		},
 		getSharedBufferForGet(id) {
 			let txn = (env.writeTxn || (readTxnRenewed ? readTxn : renewReadTxn()));
@@ -388,6 +577,7 @@ export function addReadMethods(LMDBStore, {
 					} catch(error) {}
 				}
 				readTxnRenewed = null;
+				readTxnKept = false;
 				env.close();
 			}
 			this.status = 'closed';
@@ -396,17 +586,140 @@ export function addReadMethods(LMDBStore, {
 		},
 		getStats() {
 			return this.db.stat(readTxnRenewed ? readTxn : renewReadTxn());
+		},
+		snapshot() {
+			let txn = snapshotPool.pop();
+			if (txn)
+				txn.renew();
+			else {
+				txn = env.beginTxn(0x20000);
+				if (readTxn) // a new read txn becomes the current one, switch back
+					readTxn.use(!!readTxnRenewed || readTxnKept);
+			}
+			return new Snapshot(this, txn);
 		}
 	});
 	let get = LMDBStore.prototype.get;
+	let snapshotPool = [];
+	// a consistent view of the database that is held (across any number of event turns) until it is released
+	class Snapshot {
+		constructor(store, txn) {
+			this.store = store;
+			this.txn = txn;
+			this.startTime = Date.now();
+		}
+		read(callback) {
+			let txn = this.txn;
+			if (!txn)
+				throw new Error('The snapshot has been released');
+			if (env.writeTxn)
+				throw new Error('Can not read from a snapshot inside a write transaction');
+			let previousTxn = readTxn, previousRenewed = readTxnRenewed;
+			readTxn = txn;
+			readTxnRenewed = SNAPSHOT_IN_USE;
+			txn.use(true);
+			try {
+				return callback();
+			} finally {
+				readTxn = previousTxn;
+				readTxnRenewed = previousRenewed;
+				if (previousTxn)
+					previousTxn.use(!!previousRenewed || readTxnKept);
+			}
+		}
+		get(id) {
+			// bypasses any cache, which may hold newer values
+			return this.read(() => get.call(this.store, id));
+		}
+		getEntry(id) {
+			return this.read(() => {
+				let value = get.call(this.store, id);
+				if (value !== undefined)
+					return this.store.useVersions ? { value, version: getLastVersion() } : { value };
+			});
+		}
+		getBinary(id) {
+			return this.read(() => this.store.getBinary(id));
+		}
+		doesExist(key, versionOrValue) {
+			return this.read(() => this.store.doesExist(key, versionOrValue));
+		}
+		getMany(keys) {
+			return this.read(() => this.store._getMany(keys, false));
+		}
+		getRange(options) {
+			options = Object.assign({}, options, { snapshot: true });
+			let iterable = this.read(() => this.store.getRange(options));
+			// the cursor is opened when iteration starts, and is bound to the snapshot from then on
+			let iterate = iterable[Symbol.iterator];
+			iterable[Symbol.iterator] = () => this.read(iterate);
+			return iterable;
+		}
+		getKeys(options) {
+			return this.getRange(Object.assign({}, options, { values: false }));
+		}
+		getValues(key, options) {
+			return this.getRange(Object.assign({}, options, { key, valuesForKey: true }));
+		}
+		getCount(options) {
+			return this.read(() => this.store.getCount(Object.assign({}, options, { snapshot: true })));
+		}
+		// the age of the snapshot (in milliseconds), how many commits it is behind, and the size of the pages
+		// that are retained (can't be reused) because of it
+		info() {
+			if (!this.txn)
+				throw new Error('The snapshot has been released');
+			let info = this.txn.info();
+			info.age = Date.now() - this.startTime;
+			return info;
+		}
+		release() {
+			let txn = this.txn;
+			if (!txn)
+				return;
+			this.txn = null;
+			if (txn.cursorCount > 0) {
+				// a range is still being iterated, the txn is aborted when its cursors are finished
+				txn.onlyCursor = true;
+				return;
+			}
+			if (snapshotPool.length < MAX_POOLED_SNAPSHOTS) {
+				txn.reset();
+				snapshotPool.push(txn);
+			} else
+				txn.abort();
+		}
+	}
 	function renewReadTxn() {
 		if (readTxn)
-			readTxn.renew();
+			readTxn.renew(); // this keeps the current snapshot if nothing has been committed since it was taken
 		else
 			readTxn = env.beginTxn(0x20000);
-		readTxnRenewed = setImmediate(resetReadTxn);
+		readTxnKept = false;
+		readTxnRenewed = setImmediate(endReadTxnTurn);
 		return readTxn;
 	}
+	function endReadTxnTurn() {
+		if (readTxnRenewed) {
+			renewId++;
+			readTxnRenewed = null;
+			if (readTxn.cursorCount - (readTxn.renewingCursorCount || 0) > 0) {
+				readTxn.onlyCursor = true;
+				readTxn = null;
+			}
+			else { // keep the snapshot, the next renew checks if there has been a commit since
+				readTxnKept = true;
+				// but only for the next turn of the event loop, an idle process shouldn't hold back the reclamation of pages
+				setImmediate(releaseKeptReadTxn, renewId);
+			}
+		}
+	}
+	function releaseKeptReadTxn(id) {
+		if (readTxnKept && id == renewId) {
+			readTxnKept = false;
+			readTxn.reset();
+		}
+	}
 	function resetReadTxn() {
 		if (readTxnRenewed) {
 			renewId++;
@@ -417,9 +730,48 @@ export function addReadMethods(LMDBStore, {
 			}
 			else
 				readTxn.reset();
+		} else if (readTxnKept) {
+			// don't hold on to an outdated snapshot (and the pages it references) until the next read
+			readTxnKept = false;
+			readTxn.reset();
 		}
 	}
 }
+// decodes entries that were packed by a cursor batch or parallel scan into the keys, values and versions arrays
+function decodeEntries(store, buffer, count, headerSize, includeValues, includeKeys, keys, values, versions) {
+	let dataView = buffer.dataView || new DataView(buffer.buffer, buffer.byteOffset, buffer.length);
+	let position = 0;
+	for (let i = 0; i < count; i++) {
+		let keyStart = position + headerSize;
+		let valueStart = keyStart + dataView.getUint32(position, true);
+		let valueEnd = valueStart + dataView.getUint32(position + 4, true);
+		if (includeKeys)
+			keys[i] = store.readKey(buffer, keyStart, valueStart);
+		if (includeValues) {
+			let value;
+			if (store.decoder)
+				value = store.decoder.decode(buffer.subarray(valueStart, valueEnd));
+			else if (store.encoding == 'binary')
+				value = Uint8ArraySlice.call(buffer, valueStart, valueEnd);
+			else {
+				value = buffer.toString('utf8', valueStart, valueEnd);
+				if (store.encoding == 'json' && value)
+					value = JSON.parse(value);
+			}
+			values[i] = value;
+			if (headerSize == 16)
+				versions[i] = dataView.getFloat64(position + 8, true);
+		}
+		position = (valueEnd + 7) & ~7;
+	}
+}
+function growBuffer(buffer, size) {
+	let newBuffer = Buffer.alloc((Math.max(size * 2, 0x1000) + 7) & ~7);
+	if (buffer)
+		newBuffer.set(buffer);
+	newBuffer.dataView = new DataView(newBuffer.buffer, newBuffer.byteOffset, newBuffer.length);
+	return newBuffer;
+}
 export function makeReusableBuffer(size) {
 	let bytes = Buffer.alloc(size)
 	bytes.maxLength = size;
@@ -1,20 +1,71 @@
 #include "lz4.h"
+#include "lz4hc.h"
 #include "lmdbx-js.h"
 #include <atomic>
+#include <thread>
 
 using namespace v8;
 using namespace node;
 
 thread_local LZ4_stream_t* Compression::stream = nullptr;
+static thread_local LZ4_streamHC_t* streamHC = nullptr;
+
+static int lz4CompressBound(int size) {
+    return LZ4_COMPRESSBOUND(size);
+}
+static int lz4Compress(const char* source, char* target, int sourceSize, int targetCapacity,
+        const char* dictionary, int dictionarySize, int acceleration) {
+    if (!Compression::stream)
+        Compression::stream = LZ4_createStream();
+    LZ4_loadDict(Compression::stream, dictionary, dictionarySize);
+    return LZ4_compress_fast_continue(Compression::stream, source, target, sourceSize, targetCapacity, acceleration);
+}
+static int lz4hcCompress(const char* source, char* target, int sourceSize, int targetCapacity,
+        const char* dictionary, int dictionarySize, int level) {
+    if (!streamHC)
+        streamHC = LZ4_createStreamHC();
+    LZ4_resetStreamHC_fast(streamHC, level);
+    LZ4_loadDictHC(streamHC, dictionary, dictionarySize);
+    return LZ4_compress_HC_continue(streamHC, source, target, sourceSize, targetCapacity);
+}
+// LZ4HC produces the same block format, so both LZ4 codecs decompress the same way
+static int lz4Decompress(const char* source, char* target, int compressedSize, int uncompressedSize,
+        const char* dictionary, int dictionarySize) {
+    return LZ4_decompress_safe_usingDict(source, target, compressedSize, uncompressedSize, dictionary, dictionarySize);
+}
+
+const int CODEC_LZ4 = 0;
+const int CODEC_COUNT = 3;
+// Indexed by the codec id in the header. The zstd id is reserved, it isn't available until zstd is vendored.
+static CompressionCodec codecs[CODEC_COUNT] = {
+    { "lz4", lz4CompressBound, lz4Compress, lz4Decompress },
+    { "lz4hc", lz4CompressBound, lz4hcCompress, lz4Decompress },
+    { "zstd", nullptr, nullptr, nullptr },
+};
+
 Compression::Compression() {
+    cache = nullptr;
+    for (int i = 0; i < 256; i++) {
+        dictionaries[i] = nullptr;
+        dictionarySizes[i] = 0;
+    }
+    dictionaryVersion = 0;
+    lastCompression = -1;
 }
 Compression::~Compression() {
     delete dictionary;
+    for (int i = 0; i < 256; i++)
+        delete[] dictionaries[i].load();
+    if (cache)
+        delete cache;
 }
 NAN_METHOD(Compression::ctor) {
     unsigned int compressionThreshold = 1000;
     char* dictionary = nullptr;
     unsigned int dictSize = 0;
+    int64_t cacheSize = 0;
+    int codec = CODEC_LZ4;
+    int level = LZ4HC_CLEVEL_DEFAULT;
     if (info[0]->IsObject()) {
         Local<Value> dictionaryOption = Nan::To<v8::Object>(info[0]).ToLocalChecked()->Get(Nan::GetCurrentContext(), Nan::New<String>("dictionary").ToLocalChecked()).ToLocalChecked();
         if (!dictionaryOption->IsUndefined()) {
@@ -30,16 +81,50 @@ NAN_METHOD(Compression::ctor) {
         if (thresholdOption->IsNumber()) {
             compressionThreshold = thresholdOption->IntegerValue(Nan::GetCurrentContext()).FromJust();
         }
+        Local<Value> cacheSizeOption = Nan::To<v8::Object>(info[0]).ToLocalChecked()->Get(Nan::GetCurrentContext(), Nan::New<String>("decompressedCacheSize").ToLocalChecked()).ToLocalChecked();
+        if (cacheSizeOption->IsNumber()) {
+            cacheSize = cacheSizeOption->IntegerValue(Nan::GetCurrentContext()).FromJust();
+        }
+        Local<Value> codecOption = Nan::To<v8::Object>(info[0]).ToLocalChecked()->Get(Nan::GetCurrentContext(), Nan::New<String>("codec").ToLocalChecked()).ToLocalChecked();
+        if (codecOption->IsString()) {
+            Nan::Utf8String codecName(codecOption);
+            for (codec = 0; codec < CODEC_COUNT; codec++) {
+                if (!strcmp(*codecName, codecs[codec].name))
+                    break;
+            }
+            if (codec == CODEC_COUNT)
+                return Nan::ThrowError("Unknown compression codec");
+            if (!codecs[codec].compress)
+                return Nan::ThrowError("This compression codec is not available in this build");
+        }
+        Local<Value> levelOption = Nan::To<v8::Object>(info[0]).ToLocalChecked()->Get(Nan::GetCurrentContext(), Nan::New<String>("level").ToLocalChecked()).ToLocalChecked();
+        if (levelOption->IsNumber()) {
+            level = levelOption->IntegerValue(Nan::GetCurrentContext()).FromJust();
+        }
+        Local<Value> threadsOption = Nan::To<v8::Object>(info[0]).ToLocalChecked()->Get(Nan::GetCurrentContext(), Nan::New<String>("threads").ToLocalChecked()).ToLocalChecked();
+        if (threadsOption->IsNumber()) {
+            // the compression pool is shared by the process, so this only ever grows it
+            startThreads(threadsOption->IntegerValue(Nan::GetCurrentContext()).FromJust());
+        }
     }
     Compression* compression = new Compression();
     compression->dictionary = dictionary;
+    compression->stableDictionary = dictSize ? new char[dictSize] : nullptr;
+    if (dictSize)
+        memcpy(compression->stableDictionary, dictionary, dictSize);
+    compression->stableDictionarySize = dictSize;
     compression->decompressTarget = dictionary + dictSize;
     compression->decompressSize = 0;
     compression->acceleration = 1;
+    compression->codec = codec;
+    compression->level = level;
     compression->compressionThreshold = compressionThreshold;
+    if (cacheSize > 0)
+        compression->cache = new DecompressedCache(cacheSize);
     compression->Wrap(info.This());
     compression->Ref();
     info.This()->Set(Nan::GetCurrentContext(), Nan::New<String>("address").ToLocalChecked(), Nan::New<Number>((double) (size_t) compression));
+    info.This()->Set(Nan::GetCurrentContext(), Nan::New<String>("codecId").ToLocalChecked(), Nan::New<Number>(codec));
 
     return info.GetReturnValue().Set(info.This());
 }
@@ -52,27 +137,89 @@ NAN_METHOD(Compression::setBuffer) {
     compression->decompressSize = node::Buffer::Length(info[0]) - dictSize;
 }
 
-void Compression::decompress(MDBX_val& data, bool &isValid, bool canAllocate) {
-    uint32_t uncompressedLength;
-    int compressionHeaderSize;
-    uint32_t compressedLength = data.iov_len;
-    unsigned char* charData = (unsigned char*) data.iov_base;
+NAN_METHOD(Compression::addDictionary) {
+    Compression *compression = Nan::ObjectWrap::Unwrap<Compression>(info.This());
+    int version = info[0]->Int32Value(Nan::GetCurrentContext()).FromJust();
+    if (version < 1 || version > 255)
+        return Nan::ThrowError("Dictionary version must be between 1 and 255");
+    if (!node::Buffer::HasInstance(info[1]))
+        return Nan::ThrowError("Dictionary must be a buffer");
+    if (compression->dictionaries[version].load(std::memory_order_relaxed))
+        return; // already loaded, a stored dictionary version never changes (and may be in use on other threads)
+    unsigned int size = node::Buffer::Length(info[1]);
+    char* dictionary = new char[size];
+    memcpy(dictionary, node::Buffer::Data(info[1]), size);
+    compression->dictionarySizes[version] = size;
+    compression->dictionaries[version].store(dictionary, std::memory_order_release);
+    // publish the dictionary to the compression threads after it is in place
+    int current = compression->dictionaryVersion.load(std::memory_order_relaxed);
+    if (version > current)
+        compression->dictionaryVersion.store(version, std::memory_order_release);
+}
+
+NAN_METHOD(Compression::takeLastCompression) {
+    Compression *compression = Nan::ObjectWrap::Unwrap<Compression>(info.This());
+    int lastCompression = compression->lastCompression;
+    compression->lastCompression = -1;
+    info.GetReturnValue().Set(Nan::New<Number>(lastCompression));
+}
 
+/*
+    Reads the header of a compressed value, returning the header size (or 0 if the status byte is unknown). A status
+    byte of 254 has a 24-bit length, 255 has a 48-bit length, and 253 is the extended header with the version of the
+    trained dictionary it was compressed with, the codec, a reserved byte, and a 32-bit length. The others use LZ4.
+*/
+static int readCompressionHeader(unsigned char* charData, uint32_t& uncompressedLength, int& dictionaryVersion, int& codec) {
+    dictionaryVersion = 0;
+    codec = CODEC_LZ4;
     if (charData[0] == 254) {
         uncompressedLength = ((uint32_t)charData[1] << 16) | ((uint32_t)charData[2] << 8) | (uint32_t)charData[3];
-        compressionHeaderSize = 4;
+        return 4;
     }
-    else if (charData[0] == 255) {
+    if (charData[0] == 255 || charData[0] == 253) {
+        if (charData[0] == 253) {
+            dictionaryVersion = charData[1];
+            codec = charData[2];
+        }
         uncompressedLength = ((uint32_t)charData[4] << 24) | ((uint32_t)charData[5] << 16) | ((uint32_t)charData[6] << 8) | (uint32_t)charData[7];
-        compressionHeaderSize = 8;
+        return 8;
     }
-    else {
+    return 0;
+}
+
+void Compression::decompress(MDBX_val& data, bool &isValid, bool canAllocate) {
+    uint32_t uncompressedLength;
+    int dictionaryVersion;
+    int codec;
+    uint32_t compressedLength = data.iov_len;
+    unsigned char* charData = (unsigned char*) data.iov_base;
+    int compressionHeaderSize = readCompressionHeader(charData, uncompressedLength, dictionaryVersion, codec);
+    if (!compressionHeaderSize) {
         fprintf(stderr, "Unknown status byte %u\n", charData[0]);
         if (canAllocate)
             Nan::ThrowError("Unknown status byte");
         isValid = false;
         return;
     }
+    if (codec >= CODEC_COUNT || !codecs[codec].decompress) {
+        if (canAllocate)
+            Nan::ThrowError("Value was compressed with a codec that is not available in this build");
+        isValid = false;
+        return;
+    }
+    char* dictionaryStart = dictionary;
+    int dictionarySize = decompressTarget - dictionary;
+    if (dictionaryVersion) {
+        dictionaryStart = dictionaries[dictionaryVersion].load(std::memory_order_acquire);
+        dictionarySize = dictionarySizes[dictionaryVersion];
+        if (!dictionaryStart) {
+            if (canAllocate)
+                Nan::ThrowError("Value was compressed with an unknown dictionary, the dictionaries may need to be reloaded");
+            isValid = false;
+            return;
+        }
+    }
+    lastCompression = (codec << 8) | dictionaryVersion;
     data.iov_base = decompressTarget;
     data.iov_len = uncompressedLength;
     //TODO: For larger blocks with known encoding, it might make sense to allocate space for it and use an ExternalString
@@ -81,10 +228,14 @@ void Compression::decompress(MDBX_val& data, bool &isValid, bool canAllocate) {
         isValid = false;
         return;
     }
-    int written = LZ4_decompress_safe_usingDict(
+    if (cache && cache->get((char*) charData, compressedLength, decompressTarget, uncompressedLength)) {
+        isValid = true;
+        return;
+    }
+    int written = codecs[codec].decompress(
         (char*)charData + compressionHeaderSize, decompressTarget,
         compressedLength - compressionHeaderSize, uncompressedLength,
-        dictionary, decompressTarget - dictionary);
+        dictionaryStart, dictionarySize);
     //fprintf(stdout, "first uncompressed byte %X %X %X %X %X %X\n", uncompressedData[0], uncompressedData[1], uncompressedData[2], uncompressedData[3], uncompressedData[4], uncompressedData[5]);
     if (written < 0) {
         //fprintf(stderr, "Failed to decompress data %u %u %u %u\n", charData[0], data.iov_len, compressionHeaderSize, uncompressedLength);
@@ -93,9 +244,88 @@ void Compression::decompress(MDBX_val& data, bool &isValid, bool canAllocate) {
         isValid = false;
         return;
     }
+    if (cache)
+        cache->put((char*) charData, compressedLength, decompressTarget, uncompressedLength);
     isValid = true;
 }
 
+DecompressedCache::DecompressedCache(size_t maxBytes) : maxBytes(maxBytes), bytes(0), hand(0) {
+    pthread_mutex_init(&lock, nullptr);
+}
+DecompressedCache::~DecompressedCache() {
+    for (Entry& entry : entries)
+        delete[] entry.bytes;
+    pthread_mutex_destroy(&lock);
+}
+
+bool DecompressedCache::get(const char* compressed, uint32_t compressedLength, char* target, uint32_t length) {
+    pthread_mutex_lock(&lock);
+    auto found = slots.find(compressed);
+    bool hit = false;
+    if (found != slots.end()) {
+        Entry& entry = entries[found->second];
+        // the same address may now hold different bytes, so it is only a hit if the compressed bytes still match
+        if (entry.compressedLength == compressedLength && entry.length == length &&
+                !memcmp(entry.bytes, compressed, compressedLength)) {
+            memcpy(target, entry.bytes + compressedLength, length);
+            entry.referenced = true;
+            hit = true;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return hit;
+}
+
+void DecompressedCache::put(const char* compressed, uint32_t compressedLength, const char* decompressed, uint32_t length) {
+    size_t size = (size_t) compressedLength + length;
+    if (size > (maxBytes >> 2))
+        return; // large values would flush most of the cache, and are cheap to decompress relative to their use
+    pthread_mutex_lock(&lock);
+    auto found = slots.find(compressed);
+    if (found != slots.end())
+        evict(found->second); // stale entry for a reused address
+    while (bytes + size > maxBytes && bytes > 0) {
+        if (hand >= entries.size())
+            hand = 0;
+        Entry& entry = entries[hand];
+        if (entry.bytes) {
+            if (entry.referenced)
+                entry.referenced = false;
+            else
+                evict(hand);
+        }
+        hand++;
+    }
+    size_t slot;
+    if (freeSlots.empty()) {
+        slot = entries.size();
+        entries.emplace_back();
+    } else {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    Entry& entry = entries[slot];
+    entry.address = compressed;
+    entry.compressedLength = compressedLength;
+    entry.length = length;
+    entry.bytes = new char[size];
+    memcpy(entry.bytes, compressed, compressedLength);
+    memcpy(entry.bytes + compressedLength, decompressed, length);
+    entry.referenced = false;
+    slots[compressed] = slot;
+    bytes += size;
+    pthread_mutex_unlock(&lock);
+}
+
+void DecompressedCache::evict(size_t slot) {
+    Entry& entry = entries[slot];
+    slots.erase(entry.address);
+    bytes -= (size_t) entry.compressedLength + entry.length;
+    delete[] entry.bytes;
+    entry.bytes = nullptr;
+    freeSlots.push_back(slot);
+}
+
 int Compression::compressInstruction(EnvWrap* env, double* compressionAddress) {
     MDBX_val value;
     value.iov_base = (void*)((size_t) * (compressionAddress - 1));
@@ -119,25 +349,70 @@ int Compression::compressInstruction(EnvWrap* env, double* compressionAddress) {
     }
 }
 
+int64_t Compression::decompressTo(MDBX_val& data, char* target, size_t targetSize) {
+    uint32_t uncompressedLength;
+    int dictionaryVersion;
+    int codec;
+    unsigned char* charData = (unsigned char*) data.iov_base;
+    int compressionHeaderSize = readCompressionHeader(charData, uncompressedLength, dictionaryVersion, codec);
+    if (!compressionHeaderSize || codec >= CODEC_COUNT || !codecs[codec].decompress)
+        return -1;
+    char* dictionaryStart = stableDictionary;
+    unsigned int dictionarySize = stableDictionarySize;
+    if (dictionaryVersion) {
+        dictionaryStart = dictionaries[dictionaryVersion].load(std::memory_order_acquire);
+        dictionarySize = dictionarySizes[dictionaryVersion];
+        if (!dictionaryStart)
+            return -1;
+    }
+    if (uncompressedLength > targetSize || !target)
+        return uncompressedLength;
+    if (cache && cache->get((char*) charData, data.iov_len, target, uncompressedLength))
+        return uncompressedLength;
+    int written = codecs[codec].decompress(
+        (char*)charData + compressionHeaderSize, target,
+        data.iov_len - compressionHeaderSize, uncompressedLength,
+        dictionaryStart, dictionarySize);
+    if (written < 0)
+        return -1;
+    if (cache)
+        cache->put((char*) charData, data.iov_len, target, uncompressedLength);
+    return uncompressedLength;
+}
+
 argtokey_callback_t Compression::compress(MDBX_val* value, argtokey_callback_t freeValue) {
     size_t dataLength = value->iov_len;
     char* data = (char*)value->iov_base;
     if (value->iov_len < compressionThreshold && !(value->iov_len > 0 && ((uint8_t*)data)[0] >= 250))
         return freeValue; // don't compress if less than threshold (but we must compress if the first byte is the compression indicator)
+    int version = dictionaryVersion.load(std::memory_order_acquire);
     bool longSize = dataLength >= 0x1000000;
-    int prefixSize = (longSize ? 8 : 4);
-    int maxCompressedSize = LZ4_COMPRESSBOUND(dataLength);
+    // values with a trained dictionary or another codec need the extended header to record them
+    bool extendedHeader = version || codec != CODEC_LZ4;
+    int prefixSize = (longSize || extendedHeader ? 8 : 4);
+    int maxCompressedSize = codecs[codec].compressBound(dataLength);
     char* compressed = new char[maxCompressedSize + prefixSize];
     //fprintf(stdout, "compressing %u\n", dataLength);
-    if (!stream)
-        stream = LZ4_createStream();
-    LZ4_loadDict(stream, dictionary, decompressTarget - dictionary);
-    int compressedSize = LZ4_compress_fast_continue(stream, data, compressed + prefixSize, dataLength, maxCompressedSize, acceleration);
+    int compressedSize = version ?
+        codecs[codec].compress(data, compressed + prefixSize, dataLength, maxCompressedSize,
+            dictionaries[version].load(std::memory_order_relaxed), dictionarySizes[version], codec == CODEC_LZ4 ? acceleration : level) :
+        codecs[codec].compress(data, compressed + prefixSize, dataLength, maxCompressedSize,
+            dictionary, decompressTarget - dictionary, codec == CODEC_LZ4 ? acceleration : level);
     if (compressedSize > 0) {
         if (freeValue)
             freeValue(*value);
         uint8_t* compressedData = (uint8_t*)compressed;
-        if (longSize) {
+        if (extendedHeader) {
+            compressedData[0] = 253;
+            compressedData[1] = (uint8_t)version;
+            compressedData[2] = (uint8_t)codec;
+            compressedData[3] = 0;
+            compressedData[4] = (uint8_t)(dataLength >> 24u);
+            compressedData[5] = (uint8_t)(dataLength >> 16u);
+            compressedData[6] = (uint8_t)(dataLength >> 8u);
+            compressedData[7] = (uint8_t)dataLength;
+        }
+        else if (longSize) {
             compressedData[0] = 255;
             compressedData[2] = (uint8_t)(dataLength >> 40u);
             compressedData[3] = (uint8_t)(dataLength >> 32u);
@@ -164,35 +439,151 @@ argtokey_callback_t Compression::compress(MDBX_val* value, argtokey_callback_t f
     }
 }
 
-class CompressionWorker : public Nan::AsyncWorker {
-  public:
-    CompressionWorker(EnvWrap* env, double* compressionAddress, Nan::Callback *callback)
-      : Nan::AsyncWorker(callback), env(env), compressionAddress(compressionAddress) {}
+// The compression pool is a bounded, lock-free (multi-producer, multi-consumer) ring of compression jobs,
+// consumed by a fixed set of threads that sleep on a wake sequence word when there is no work.
+const unsigned int COMPRESSION_QUEUE_SIZE = 4096; // must be a power of two
+const unsigned int MAX_COMPRESSION_THREADS = 16;
+
+struct CompressionJob {
+    std::atomic<size_t> sequence;
+    EnvWrap* env;
+    double* compressionAddress;
+    // the count of queued jobs in the instruction buffer, which isn't reused until it is zero
+    std::atomic<uint32_t>* bufferJobs;
+};
+
+static CompressionJob* compressionQueue;
+static std::atomic<size_t> enqueuePosition;
+static std::atomic<size_t> dequeuePosition;
+static std::atomic<uint32_t> wakeSequence;
+static std::atomic<int> sleepingThreads;
+static unsigned int compressionThreads = 0;
+static pthread_mutex_t* initCompressionLock() {
+    pthread_mutex_t* mutex = new pthread_mutex_t;
+    pthread_mutex_init(mutex, nullptr);
+    return mutex;
+}
+static pthread_mutex_t* compressionLock = initCompressionLock();
+
+static bool pushCompressionJob(EnvWrap* env, double* compressionAddress, std::atomic<uint32_t>* bufferJobs) {
+    CompressionJob* job;
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+        job = &compressionQueue[position & (COMPRESSION_QUEUE_SIZE - 1)];
+        intptr_t diff = (intptr_t) job->sequence.load(std::memory_order_acquire) - (intptr_t) position;
+        if (diff == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0)
+            return false; // queue is full
+        else
+            position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+    job->env = env;
+    job->compressionAddress = compressionAddress;
+    job->bufferJobs = bufferJobs;
+    job->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
 
+static bool popCompressionJob(EnvWrap** env, double** compressionAddress, std::atomic<uint32_t>** bufferJobs) {
+    CompressionJob* job;
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    for (;;) {
+        job = &compressionQueue[position & (COMPRESSION_QUEUE_SIZE - 1)];
+        intptr_t diff = (intptr_t) job->sequence.load(std::memory_order_acquire) - (intptr_t) (position + 1);
+        if (diff == 0) {
+            if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0)
+            return false; // queue is empty
+        else
+            position = dequeuePosition.load(std::memory_order_relaxed);
+    }
+    *env = job->env;
+    *compressionAddress = job->compressionAddress;
+    *bufferJobs = job->bufferJobs;
+    job->sequence.store(position + COMPRESSION_QUEUE_SIZE, std::memory_order_release);
+    return true;
+}
 
-    void Execute() {
-        uint64_t compressionPointer;
-        compressionPointer = std::atomic_exchange((std::atomic<int64_t>*) compressionAddress, (int64_t) 2);
-        if (compressionPointer > 1) {
+static void runCompressionJob(EnvWrap* env, double* compressionAddress, std::atomic<uint32_t>* bufferJobs) {
+    if (!env->compressionCancelled.load(std::memory_order_acquire)) {
+        // claim the instruction, only if it is still waiting to be compressed, the writer may have already claimed
+        // it (1) and finished compressing it (0) itself
+        std::atomic<int64_t>* status = (std::atomic<int64_t>*) compressionAddress;
+        int64_t compressionPointer = status->load(std::memory_order_acquire);
+        while (compressionPointer > 2 && !status->compare_exchange_weak(compressionPointer, (int64_t) 2)) {}
+        if (compressionPointer > 2) {
             Compression* compression = (Compression*)(size_t) * ((double*)&compressionPointer);
             compression->compressInstruction(env, compressionAddress);
         }
     }
-    void HandleOKCallback() {
-        // don't actually call the callback, no need
-    }
+    // once these are released, the instruction buffer can be reused and the environment can be closed
+    bufferJobs->fetch_sub(1, std::memory_order_release);
+    env->compressionJobs.fetch_sub(1, std::memory_order_release);
+}
 
-  private:
+static void compressionThread(void* data) {
     EnvWrap* env;
     double* compressionAddress;
-};
+    std::atomic<uint32_t>* bufferJobs;
+    for (;;) {
+        if (popCompressionJob(&env, &compressionAddress, &bufferJobs)) {
+            runCompressionJob(env, compressionAddress, bufferJobs);
+            continue;
+        }
+        uint32_t sequence = wakeSequence.load();
+        sleepingThreads++;
+        // check again after registering as sleeping, so we can't miss a job that was pushed in between
+        if (popCompressionJob(&env, &compressionAddress, &bufferJobs)) {
+            sleepingThreads--;
+            runCompressionJob(env, compressionAddress, bufferJobs);
+            continue;
+        }
+        futex_wait((uint32_t*) &wakeSequence, sequence);
+        sleepingThreads--;
+    }
+}
+
+void Compression::startThreads(unsigned int threads) {
+    if (threads > MAX_COMPRESSION_THREADS)
+        threads = MAX_COMPRESSION_THREADS;
+    pthread_mutex_lock(compressionLock);
+    if (!compressionQueue) {
+        compressionQueue = new CompressionJob[COMPRESSION_QUEUE_SIZE];
+        for (unsigned int i = 0; i < COMPRESSION_QUEUE_SIZE; i++)
+            compressionQueue[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    while (compressionThreads < threads) {
+        uv_thread_t thread;
+        if (uv_thread_create(&thread, compressionThread, nullptr))
+            break;
+        compressionThreads++;
+    }
+    pthread_mutex_unlock(compressionLock);
+}
 
 NAN_METHOD(EnvWrap::compress) {
     EnvWrap *env = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
     size_t compressionAddress = Local<Number>::Cast(info[0])->Value();
-    Nan::Callback* callback = new Nan::Callback(Local<v8::Function>::Cast(info[1]));
-    CompressionWorker* worker = new CompressionWorker(env, (double*) compressionAddress, callback);
-    Nan::AsyncQueueWorker(worker);
+    std::atomic<uint32_t>* bufferJobs = (std::atomic<uint32_t>*) (size_t) Local<Number>::Cast(info[1])->Value();
+    if (!compressionThreads) {
+        unsigned int threads = std::thread::hardware_concurrency();
+        // leave a core for the writer thread
+        Compression::startThreads(threads > 2 ? (threads > 5 ? 4 : threads - 1) : 1);
+    }
+    bufferJobs->fetch_add(1, std::memory_order_relaxed);
+    env->compressionJobs.fetch_add(1, std::memory_order_relaxed);
+    // if the queue is full, the writer thread will just compress this value itself when it reaches it
+    if (pushCompressionJob(env, (double*) compressionAddress, bufferJobs)) {
+        wakeSequence++;
+        if (sleepingThreads.load() > 0)
+            futex_wake((uint32_t*) &wakeSequence);
+    } else {
+        bufferJobs->fetch_sub(1, std::memory_order_relaxed);
+        env->compressionJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
 }
 
 
@@ -9,6 +9,8 @@ CursorWrap::CursorWrap(MDBX_cursor *cursor) {
     this->keyType = NodeLmdbxKeyType::StringKey;
     this->freeKey = nullptr;
     this->endKey.iov_len = 0; // indicates no end key (yet)
+    this->batchCurrent = false;
+    this->txnId = 0;
 }
 
 CursorWrap::~CursorWrap() {
@@ -56,6 +58,7 @@ NAN_METHOD(CursorWrap::ctor) {
     cw->dw = dw;
     cw->dw->Ref();
     cw->txn = txn;
+    cw->txnId = mdbx_txn_id(txn);
     cw->keyType = keyType;
     cw->Wrap(info.This());
 
@@ -99,6 +102,17 @@ NAN_METHOD(CursorWrap::del) {
         return throwLmdbxError(rc);
     }
 }
+bool CursorWrap::pastEnd(MDBX_val &key, MDBX_val &data) {
+    if (endKey.iov_len == 0)
+        return false;
+    int comparison;
+    if (flags & 0x800)
+        comparison = mdbx_dcmp(txn, dw->dbi, &endKey, &data);
+    else
+        comparison = mdbx_cmp(txn, dw->dbi, &endKey, &key);
+    return (flags & 0x400) ? comparison >= 0 : (comparison <= 0);
+}
+
 int CursorWrap::returnEntry(int lastRC, MDBX_val &key, MDBX_val &data) {
     if (lastRC) {
         if (lastRC == MDBX_NOTFOUND)
@@ -108,16 +122,8 @@ int CursorWrap::returnEntry(int lastRC, MDBX_val &key, MDBX_val &data) {
             return 0;
         }
     }   
-    if (endKey.iov_len > 0) {
-        int comparison;
-        if (flags & 0x800)
-            comparison = mdbx_dcmp(txn, dw->dbi, &endKey, &data);
-        else
-            comparison = mdbx_cmp(txn, dw->dbi, &endKey, &key);
-        if ((flags & 0x400) ? comparison >= 0 : (comparison <= 0)) {
-            return 0;
-        }
-    }
+	if (pastEnd(key, data))
+		return 0;
 	char* keyBuffer = dw->ew->keyBuffer;
 	if (flags & 0x100) {
         bool result = getVersionAndUncompress(data, dw);
@@ -136,8 +142,16 @@ uint32_t CursorWrap::doPosition(uint32_t offset, uint32_t keySize, uint64_t endK
     //char* keyBuffer = dw->ew->keyBuffer;
     MDBX_val key, data;
     int rc;
-    if (flags & 0x2000) // TODO: check the txn_id to determine if we need to renew
-        mdbx_cursor_renew(mdbx_cursor_txn(cursor), cursor);
+    if (flags & 0x2000) {
+        // the shared read txn keeps its snapshot if nothing was committed, and then the cursor is still valid
+        MDBX_txn* txn = mdbx_cursor_txn(cursor);
+        uint64_t currentTxnId = mdbx_txn_id(txn);
+        if (currentTxnId != txnId) {
+            mdbx_cursor_renew(txn, cursor);
+            txnId = currentTxnId;
+        }
+    }
+    batchCurrent = false;
     if (endKeyAddress) {
         uint32_t* keyBuffer = (uint32_t*) endKeyAddress;
         endKey.iov_len = *keyBuffer;
@@ -153,6 +167,34 @@ uint32_t CursorWrap::doPosition(uint32_t offset, uint32_t keySize, uint64_t endK
             MDBX_NEXT_NODUP;
     key.iov_len = keySize;
     key.iov_base = dw->ew->keyBuffer;
+    // counts that don't need to walk the range: estimates, and the whole database (unless we are only counting the
+    // keys of a dupsort database)
+    if ((flags & 0x1000) && !(flags & 0x800) && ((flags & 0x8000) || (keySize == 0 && endKey.iov_len == 0 &&
+            ((flags & 0x100) || !(dw->flags & (int) MDBX_DUPSORT))))) {
+        MDBX_txn* cursorTxn = mdbx_cursor_txn(cursor);
+        uint64_t count;
+        if (flags & 0x8000) { // estimate from the b-tree structure
+            ptrdiff_t distance;
+            MDBX_val* start = keySize > 0 ? &key : nullptr;
+            MDBX_val* end = endKey.iov_len > 0 ? &endKey : nullptr;
+            rc = (flags & 0x400) ? mdbx_estimate_range(cursorTxn, dw->dbi, end, nullptr, start, nullptr, &distance) :
+                mdbx_estimate_range(cursorTxn, dw->dbi, start, nullptr, end, nullptr, &distance);
+            if (rc) {
+                throwLmdbxError(rc);
+                return 0;
+            }
+            count = distance > 0 ? distance : 0;
+        } else { // the number of entries is in the stats
+            MDBX_stat stat;
+            rc = mdbx_dbi_stat(cursorTxn, dw->dbi, &stat, sizeof(stat));
+            if (rc) {
+                throwLmdbxError(rc);
+                return 0;
+            }
+            count = stat.ms_entries;
+        }
+        return count > offset ? count - offset : 0;
+    }
     if (key.iov_len == 0) {
         rc = mdbx_cursor_get(cursor, &key, &data, flags & 0x400 ? MDBX_LAST : MDBX_FIRST);  
     } else {
@@ -298,6 +340,83 @@ void CursorWrap::iterate(
     return info.GetReturnValue().Set(Nan::New<Number>(cw->returnEntry(rc, key, data)));
 }
 
+size_t packEntry(char* target, size_t targetSize, size_t position, MDBX_val &key, MDBX_val &data,
+        bool includeValues, bool hasVersions, Compression* compression, bool &fits) {
+    size_t headerSize = hasVersions ? 16 : 8;
+    size_t valuePosition = position + headerSize + key.iov_len;
+    size_t valueSize = 0;
+    if (includeValues) {
+        MDBX_val value = data;
+        if (hasVersions) {
+            value.iov_base = (char*) value.iov_base + 8;
+            value.iov_len -= 8;
+        }
+        if (compression && value.iov_len > 0 && ((unsigned char*) value.iov_base)[0] >= 250) {
+            // decompress straight into the target (this does nothing if it doesn't fit)
+            int64_t uncompressedLength = compression->decompressTo(value,
+                valuePosition < targetSize ? target + valuePosition : nullptr,
+                valuePosition < targetSize ? targetSize - valuePosition : 0);
+            if (uncompressedLength < 0)
+                return 0;
+            valueSize = uncompressedLength;
+        } else {
+            valueSize = value.iov_len;
+            if (valuePosition + valueSize <= targetSize)
+                memcpy(target + valuePosition, value.iov_base, valueSize);
+        }
+    }
+    fits = valuePosition + valueSize <= targetSize;
+    if (fits) {
+        uint32_t* header = (uint32_t*) (target + position);
+        header[0] = key.iov_len;
+        header[1] = valueSize;
+        if (hasVersions)
+            *((double*) (header + 2)) = *((double*) data.iov_base);
+        memcpy(target + position + headerSize, key.iov_base, key.iov_len);
+    }
+    return (valuePosition + valueSize + 7) & ~7;
+}
+
+NAN_METHOD(CursorWrap::iterateBatch) {
+    CursorWrap* cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.Holder());
+    char* target = node::Buffer::Data(info[0]);
+    size_t targetSize = node::Buffer::Length(info[0]);
+    uint32_t maxCount = info[1]->Uint32Value(Nan::GetCurrentContext()).FromJust();
+    bool includeValues = cw->flags & 0x100;
+    bool hasVersions = includeValues && cw->dw->hasVersions;
+    size_t position = 0;
+    uint32_t count = 0;
+    MDBX_val key, data;
+    while (count < maxCount) {
+        int rc = mdbx_cursor_get(cw->cursor, &key, &data, cw->batchCurrent ? MDBX_GET_CURRENT : cw->iteratingOp);
+        cw->batchCurrent = false;
+        if (rc) {
+            if (rc != MDBX_NOTFOUND)
+                return throwLmdbxError(rc);
+            break;
+        }
+        if (cw->pastEnd(key, data)) {
+            cw->batchCurrent = true; // stay on this entry, so any further batches stop here as well
+            break;
+        }
+        bool fits;
+        size_t end = packEntry(target, targetSize, position, key, data, includeValues, hasVersions, cw->dw->compression, fits);
+        if (!end)
+            return Nan::ThrowError("Failed to decompress data");
+        if (!fits) {
+            cw->batchCurrent = true;
+            if (count == 0) {
+                *((uint32_t*) target) = end;
+                return info.GetReturnValue().Set(Nan::New<Number>(0xffffffff));
+            }
+            break;
+        }
+        position = end;
+        count++;
+    }
+    info.GetReturnValue().Set(Nan::New<Number>(count));
+}
+
 NAN_METHOD(CursorWrap::getCurrentValue) {
     CursorWrap* cw = Nan::ObjectWrap::Unwrap<CursorWrap>(info.Holder());
     MDBX_val key, data;
@@ -312,6 +431,7 @@ NAN_METHOD(CursorWrap::renew) {
     if (rc != 0) {
         return throwLmdbxError(rc);
     }
+    cw->txnId = mdbx_txn_id(cw->txn);
 }
 
 void CursorWrap::setupExports(Local<Object> exports) {
@@ -323,6 +443,7 @@ void CursorWrap::setupExports(Local<Object> exports) {
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("close").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::close));
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("del").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::del));
     cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("getCurrentValue").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::getCurrentValue));
+    cursorTpl->PrototypeTemplate()->Set(Nan::New<String>("iterateBatch").ToLocalChecked(), Nan::New<FunctionTemplate>(CursorWrap::iterateBatch));
 
     Isolate *isolate = Isolate::GetCurrent();
     #ifdef ENABLE_FAST_API
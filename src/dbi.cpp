@@ -323,6 +323,257 @@ NAN_METHOD(DbiWrap::getStringByBinary) {
         return info.GetReturnValue().Set(Nan::New<Number>(data.iov_len));
 }
 
+void getManyKeyOrder(MDBX_txn* txn, MDBX_dbi dbi, char* keyBlock, uint32_t count, bool sorted,
+        std::vector<MDBX_val>& keys, std::vector<uint32_t>& order) {
+    // the key block is a sequence of 32-bit size prefixed keys, each padded to a 4-byte boundary
+    keys.resize(count);
+    order.resize(count);
+    char* position = keyBlock;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t size = *((uint32_t*) position);
+        keys[i].iov_len = size;
+        keys[i].iov_base = position + 4;
+        position += (size + 7) & ~3;
+        order[i] = i;
+    }
+    if (!sorted) {
+        // visit the keys in database order, so the cursor sweeps forward through the b-tree, rather
+        // than descending from the root for each random key
+        std::sort(order.begin(), order.end(), [txn, dbi, &keys](uint32_t a, uint32_t b) {
+            return mdbx_cmp(txn, dbi, &keys[a], &keys[b]) < 0;
+        });
+    }
+}
+
+NAN_METHOD(DbiWrap::getMany) {
+    v8::Local<v8::Object> instance =
+      v8::Local<v8::Object>::Cast(info.Holder());
+    DbiWrap* dw = Nan::ObjectWrap::Unwrap<DbiWrap>(instance);
+    char* keyBlock = node::Buffer::Data(info[0]);
+    uint32_t count = info[1]->Uint32Value(Nan::GetCurrentContext()).FromJust();
+    char* target = node::Buffer::Data(info[2]);
+    size_t targetSize = node::Buffer::Length(info[2]);
+    int flags = info[3]->IntegerValue(Nan::GetCurrentContext()).FromJust();
+    MDBX_txn* txn = dw->ew->getReadTxn();
+
+    std::vector<MDBX_val> keys;
+    std::vector<uint32_t> order;
+    getManyKeyOrder(txn, dw->dbi, keyBlock, count, flags & GET_MANY_SORTED, keys, order);
+    MDBX_cursor* cursor;
+    int rc = mdbx_cursor_open(txn, dw->dbi, &cursor);
+    if (rc)
+        return throwLmdbxError(rc);
+    // in exists-only mode, the result is just one byte per key, otherwise there is a table of 32-bit
+    // offset and length pairs (in the original key order), followed by the value data
+    bool existsOnly = flags & GET_MANY_EXISTS_ONLY;
+    size_t end = existsOnly ? count : (size_t) count * 8;
+    MDBX_val data;
+    dw->getFast = true;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = order[i];
+        rc = mdbx_cursor_get(cursor, &keys[index], &data, MDBX_SET_KEY);
+        if (rc && rc != MDBX_NOTFOUND) {
+            dw->getFast = false;
+            mdbx_cursor_close(cursor);
+            return throwLmdbxError(rc);
+        }
+        if (existsOnly) {
+            if (index < targetSize)
+                target[index] = rc ? 0 : 1;
+            continue;
+        }
+        uint32_t* entry = (uint32_t*) (target + index * 8);
+        bool fits = (size_t) index * 8 + 8 <= targetSize;
+        if (rc == MDBX_NOTFOUND) {
+            if (fits)
+                entry[0] = 0xffffffff;
+            continue;
+        }
+        if (!getVersionAndUncompress(data, dw)) {
+            dw->getFast = false;
+            mdbx_cursor_close(cursor);
+            if (dw->compression && data.iov_base == dw->compression->decompressTarget &&
+                    data.iov_len > dw->compression->decompressSize)
+                // the decompression buffer is too small, let JS allocate a larger one and retry
+                return info.GetReturnValue().Set(Nan::New<Number>(-(double) data.iov_len));
+            return Nan::ThrowError("Failed to decompress data");
+        }
+        if (fits) {
+            entry[0] = end;
+            entry[1] = data.iov_len;
+        }
+        if (end + data.iov_len <= targetSize)
+            memcpy(target + end, data.iov_base, data.iov_len);
+        end += data.iov_len;
+    }
+    dw->getFast = false;
+    mdbx_cursor_close(cursor);
+    // the total size required, if this is larger than the target, the caller needs to grow it and retry
+    info.GetReturnValue().Set(Nan::New<Number>((double) end));
+}
+
+NAN_METHOD(DbiWrap::getManyAsync) {
+    v8::Local<v8::Object> instance =
+      v8::Local<v8::Object>::Cast(info.Holder());
+    DbiWrap* dw = Nan::ObjectWrap::Unwrap<DbiWrap>(instance);
+    size_t keyBlockSize = info[1]->Uint32Value(Nan::GetCurrentContext()).FromJust();
+    ReadJob* job = new ReadJob();
+    // copy the keys, so the JS side can reuse its key buffer right away
+    job->keys = new char[keyBlockSize];
+    memcpy(job->keys, node::Buffer::Data(info[0]), keyBlockSize);
+    job->count = info[2]->Uint32Value(Nan::GetCurrentContext()).FromJust();
+    job->flags = info[3]->IntegerValue(Nan::GetCurrentContext()).FromJust();
+    job->callback = new Nan::Callback(Local<v8::Function>::Cast(info[4]));
+    job->ew = dw->ew;
+    job->dbi = dw->dbi;
+    job->hasVersions = dw->hasVersions;
+    job->compression = dw->compression;
+    job->result = nullptr;
+    job->resultSize = 0;
+    job->error = nullptr;
+    dw->ew->getReadPool()->Enqueue(job);
+}
+
+// the position of a key within the key space, from the 8 bytes after the common prefix (or the value of an integer key)
+static uint64_t keyPosition(MDBX_val &key, size_t prefixLength, bool integerKey) {
+    if (integerKey)
+        return key.iov_len == 8 ? *((uint64_t*) key.iov_base) : *((uint32_t*) key.iov_base);
+    uint64_t position = 0;
+    for (size_t i = prefixLength; i < prefixLength + 8; i++)
+        position = (position << 8) | (i < key.iov_len ? ((unsigned char*) key.iov_base)[i] : 0);
+    return position;
+}
+
+// the (shortest) key at a position in the key space, written after the prefix in the storage
+static MDBX_val keyAtPosition(uint64_t position, char* storage, size_t prefixLength, bool integerKey, size_t integerSize) {
+    MDBX_val key;
+    key.iov_base = storage;
+    if (integerKey) {
+        if (integerSize == 8)
+            *((uint64_t*) storage) = position;
+        else
+            *((uint32_t*) storage) = (uint32_t) position;
+        key.iov_len = integerSize;
+        return key;
+    }
+    size_t length = prefixLength + 1;
+    for (size_t i = 0; i < 8; i++) {
+        unsigned char byte = (unsigned char) (position >> (56 - i * 8));
+        storage[prefixLength + i] = byte;
+        if (byte)
+            length = prefixLength + i + 1;
+    }
+    key.iov_len = length;
+    return key;
+}
+
+NAN_METHOD(DbiWrap::getPartitions) {
+    v8::Local<v8::Object> instance =
+      v8::Local<v8::Object>::Cast(info.Holder());
+    DbiWrap* dw = Nan::ObjectWrap::Unwrap<DbiWrap>(instance);
+    uint32_t partitions = info[1]->Uint32Value(Nan::GetCurrentContext()).FromJust();
+    MDBX_txn* txn = dw->ew->getReadTxn();
+    std::vector<MDBX_val> bounds;
+    std::vector<uint32_t> order;
+    getManyKeyOrder(txn, dw->dbi, node::Buffer::Data(info[0]), 2, true, bounds, order);
+    MDBX_val* start = bounds[0].iov_len ? &bounds[0] : nullptr;
+    MDBX_val* end = bounds[1].iov_len ? &bounds[1] : nullptr;
+    Local<Array> splits = Nan::New<Array>(0);
+    info.GetReturnValue().Set(splits);
+    // reverse keys aren't ordered by their leading bytes, so we can't search the key space
+    if (partitions < 2 || (dw->flags & (int) MDBX_REVERSEKEY))
+        return;
+    MDBX_cursor* cursor;
+    int rc = mdbx_cursor_open(txn, dw->dbi, &cursor);
+    if (rc)
+        return throwLmdbxError(rc);
+    // find the actual first and last keys, to narrow down the key space
+    MDBX_val low, high, data;
+    if (start) {
+        low = *start;
+        rc = mdbx_cursor_get(cursor, &low, &data, MDBX_SET_RANGE);
+    } else
+        rc = mdbx_cursor_get(cursor, &low, &data, MDBX_FIRST);
+    if (rc == 0) {
+        if (end)
+            high = *end;
+        else
+            rc = mdbx_cursor_get(cursor, &high, &data, MDBX_LAST);
+    }
+    ptrdiff_t total = 0;
+    if (rc == 0)
+        rc = mdbx_estimate_range(txn, dw->dbi, start, nullptr, end, nullptr, &total);
+    if (rc || total < (ptrdiff_t) partitions * 2) {
+        mdbx_cursor_close(cursor);
+        if (rc && rc != MDBX_NOTFOUND)
+            return throwLmdbxError(rc);
+        return; // too small to split
+    }
+    bool integerKey = dw->flags & (int) MDBX_INTEGERKEY;
+    size_t prefixLength = 0;
+    if (!integerKey) {
+        while (prefixLength < low.iov_len && prefixLength < high.iov_len &&
+                ((char*) low.iov_base)[prefixLength] == ((char*) high.iov_base)[prefixLength])
+            prefixLength++;
+    }
+    std::vector<char> storage(prefixLength + 8);
+    memcpy(storage.data(), low.iov_base, prefixLength);
+    uint64_t searchFrom = keyPosition(low, prefixLength, integerKey);
+    uint64_t searchTo = keyPosition(high, prefixLength, integerKey);
+    MDBX_val previous = low;
+    uint32_t count = 0;
+    for (uint32_t i = 1; i < partitions; i++) {
+        // bisect the key space for the position where the estimated distance from the start reaches the next split
+        ptrdiff_t target = total * i / partitions;
+        uint64_t lower = searchFrom, upper = searchTo;
+        while (lower < upper) {
+            uint64_t middle = lower + (upper - lower) / 2;
+            MDBX_val key = keyAtPosition(middle, storage.data(), prefixLength, integerKey, low.iov_len);
+            ptrdiff_t distance;
+            rc = mdbx_estimate_range(txn, dw->dbi, start, nullptr, &key, nullptr, &distance);
+            if (rc)
+                break;
+            if (distance < target)
+                lower = middle + 1;
+            else
+                upper = middle;
+        }
+        searchFrom = lower;
+        // and move to an actual key, so the split can be decoded
+        MDBX_val split = keyAtPosition(lower, storage.data(), prefixLength, integerKey, low.iov_len);
+        if (rc == 0)
+            rc = mdbx_cursor_get(cursor, &split, &data, MDBX_SET_RANGE);
+        if (rc)
+            break;
+        if (end && mdbx_cmp(txn, dw->dbi, &split, end) >= 0)
+            break;
+        if (mdbx_cmp(txn, dw->dbi, &split, &previous) <= 0)
+            continue; // would be an empty partition
+        (void)splits->Set(Nan::GetCurrentContext(), count++,
+            Nan::CopyBuffer((char*) split.iov_base, split.iov_len).ToLocalChecked());
+        previous = split;
+    }
+    mdbx_cursor_close(cursor);
+    if (rc && rc != MDBX_NOTFOUND)
+        return throwLmdbxError(rc);
+}
+
+NAN_METHOD(DbiWrap::scanParallel) {
+    v8::Local<v8::Object> instance =
+      v8::Local<v8::Object>::Cast(info.Holder());
+    DbiWrap* dw = Nan::ObjectWrap::Unwrap<DbiWrap>(instance);
+    size_t boundsSize = info[1]->Uint32Value(Nan::GetCurrentContext()).FromJust();
+    char* bounds = new char[boundsSize];
+    memcpy(bounds, node::Buffer::Data(info[0]), boundsSize);
+    uint32_t partitions = info[2]->Uint32Value(Nan::GetCurrentContext()).FromJust();
+    ScanWorker* worker = new ScanWorker(dw, new Nan::Callback(Local<v8::Function>::Cast(info[4])), info[3]->IsTrue());
+    const char* error = worker->Start(bounds, partitions);
+    if (error) {
+        delete worker;
+        return Nan::ThrowError(error);
+    }
+}
+
 // This file contains code from the node-lmdb project
 // Copyright (c) 2013-2017 Timur Kristóf
 // Copyright (c) 2021 Kristopher Tate
@@ -1,4 +1,6 @@
 #include "lmdbx-js.h"
+#include <atomic>
+#include <thread>
 using namespace v8;
 using namespace node;
 
@@ -21,7 +23,11 @@ EnvWrap::EnvWrap() {
 	this->currentReadTxn = nullptr;
     this->writeTxn = nullptr;
     this->writeWorker = nullptr;
+    this->readPool = nullptr;
 	this->readTxnRenewed = false;
+    this->compressionJobs = 0;
+    this->compressionCancelled = false;
+    this->syncPeriod = 0;
     this->writingLock = new pthread_mutex_t;
     this->writingCond = new pthread_cond_t;
     pthread_mutex_init(this->writingLock, nullptr);
@@ -86,62 +92,172 @@ int applyUint32Setting(int (*f)(MDBX_env *, T), MDBX_env* e, Local<Object> optio
     return rc;
 }
 
-class SyncWorker : public Nan::AsyncWorker {
-  public:
-    SyncWorker(MDBX_env* env, Nan::Callback *callback)
-      : Nan::AsyncWorker(callback), env(env) {}
-
-    void Execute() {
-/*       int rc = mdbx_env_sync(env, 1);
-        if (rc != 0) {
-            SetErrorMessage(mdbx_strerror(rc));
-        }*/
-    }
-
-    void HandleOKCallback() {
-        Nan::HandleScope scope;
-        Local<v8::Value> argv[] = {
-            Nan::Null()
-        };
-
-        callback->Call(1, argv, async_resource);
-    }
-
-  private:
-    MDBX_env* env;
-};
+const unsigned int COPY_CHUNK_SIZE = 0x100000;
+#if UV_VERSION_MAJOR > 1 || UV_VERSION_MINOR >= 41
+#define HAS_UV_PIPE 1
+#endif
 
-class CopyWorker : public Nan::AsyncWorker {
+/*
+    Copies (backs up) the environment on its own thread, so a long backup doesn't occupy the libuv threadpool.
+    When there is a bytes/sec limit or a progress callback, the copy is written through a pipe and pumped to the
+    destination by a second thread, so it can be measured and throttled.
+*/
+class CopyWorker {
   public:
-    CopyWorker(MDBX_env* env, char* inPath, int flags, Nan::Callback *callback)
-      : Nan::AsyncWorker(callback), env(env), path(strdup(inPath)), flags(flags) {
-      }
+    CopyWorker(EnvWrap* ew, MDBX_copy_flags_t flags, Nan::Callback* callback)
+      : ew(ew), flags(flags), callback(callback) {
+        path = nullptr;
+        fd = -1;
+        bytesPerSecond = 0;
+        progress = nullptr;
+        bytesCopied = 0;
+        finished = false;
+        pumpError = 0;
+        error = nullptr;
+    }
     ~CopyWorker() {
         free(path);
+        delete callback;
+        delete progress;
+        delete asyncResource;
+        delete events;
+        ew->Unref();
     }
-
-    void Execute() {
-/*        int rc = mdbx_env_copy2(env, path, flags);
-        if (rc != 0) {
-            fprintf(stderr, "Error on copy code: %u\n", rc);
-            SetErrorMessage("Error on copy");
-        }*/
+    void Start() {
+        ew->Ref(); // keep the environment open until we are done
+        asyncResource = new Nan::AsyncResource("lmdbx:copy");
+        events = new uv_async_t;
+        uv_async_init(Nan::GetCurrentEventLoop(), events, HandleEvents);
+        events->data = this;
+        uv_thread_create(&thread, Run, this);
     }
+    char* path;
+    uv_file fd;
+    double bytesPerSecond;
+    Nan::Callback* progress;
 
-    void HandleOKCallback() {
+  private:
+    static void Run(void* data) {
+        CopyWorker* worker = (CopyWorker*) data;
+        int rc;
+#ifdef HAS_UV_PIPE
+        if (worker->bytesPerSecond > 0 || worker->progress) {
+            uv_fs_t req;
+            worker->target = worker->fd;
+            if (worker->path) {
+                worker->target = uv_fs_open(nullptr, &req, worker->path, UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_EXCL, 0664, nullptr);
+                uv_fs_req_cleanup(&req);
+            }
+            uv_file pipe[2];
+            rc = worker->target < 0 ? worker->target : uv_pipe(pipe, 0, 0);
+            if (rc) {
+                worker->error = uv_strerror(rc);
+            } else {
+                worker->pipeRead = pipe[0];
+                uv_thread_t pumpThread;
+                uv_thread_create(&pumpThread, Pump, worker);
+                rc = mdbx_env_copy2fd(worker->ew->env, (mdbx_filehandle_t) uv_get_osfhandle(pipe[1]), worker->flags);
+                uv_fs_close(nullptr, &req, pipe[1], nullptr);
+                uv_fs_req_cleanup(&req);
+                uv_thread_join(&pumpThread);
+                if (worker->pumpError) // this is the cause of any copy error
+                    worker->error = uv_strerror(worker->pumpError);
+                else if (rc)
+                    worker->error = mdbx_strerror(rc);
+            }
+            if (worker->path && worker->target >= 0) {
+                uv_fs_close(nullptr, &req, worker->target, nullptr);
+                uv_fs_req_cleanup(&req);
+            }
+        } else
+#endif
+        {
+            rc = worker->path ? mdbx_env_copy(worker->ew->env, worker->path, worker->flags) :
+                mdbx_env_copy2fd(worker->ew->env, (mdbx_filehandle_t) uv_get_osfhandle(worker->fd), worker->flags);
+            if (rc)
+                worker->error = mdbx_strerror(rc);
+        }
+        worker->finished = true;
+        uv_async_send(worker->events);
+    }
+    static void Pump(void* data) {
+        CopyWorker* worker = (CopyWorker*) data;
+        char* buffer = new char[COPY_CHUNK_SIZE];
+        uv_fs_t req;
+        uint64_t start = uv_hrtime();
+        while (true) {
+            uv_buf_t buf = uv_buf_init(buffer, COPY_CHUNK_SIZE);
+            int bytesRead = uv_fs_read(nullptr, &req, worker->pipeRead, &buf, 1, -1, nullptr);
+            uv_fs_req_cleanup(&req);
+            if (bytesRead <= 0) {
+                if (bytesRead < 0)
+                    worker->pumpError = bytesRead;
+                break;
+            }
+            char* position = buffer;
+            while (position < buffer + bytesRead) {
+                buf = uv_buf_init(position, buffer + bytesRead - position);
+                int written = uv_fs_write(nullptr, &req, worker->target, &buf, 1, -1, nullptr);
+                uv_fs_req_cleanup(&req);
+                if (written < 0) {
+                    worker->pumpError = written;
+                    break;
+                }
+                position += written;
+            }
+            if (worker->pumpError)
+                break;
+            uint64_t copied = worker->bytesCopied += bytesRead;
+            if (worker->progress)
+                uv_async_send(worker->events);
+            if (worker->bytesPerSecond > 0) {
+                // wait until we are back under the rate limit
+                uint64_t due = start + (uint64_t) (copied / worker->bytesPerSecond * 1e9);
+                uint64_t now = uv_hrtime();
+                if (due > now)
+                    uv_sleep((due - now) / 1000000);
+            }
+        }
+        delete[] buffer;
+        // closing the read end makes the copy fail (rather than block) if we stopped early
+        uv_fs_close(nullptr, &req, worker->pipeRead, nullptr);
+        uv_fs_req_cleanup(&req);
+    }
+    static void HandleEvents(uv_async_t* handle) {
+        CopyWorker* worker = (CopyWorker*) handle->data;
         Nan::HandleScope scope;
+        if (worker->progress) {
+            Local<v8::Value> argv[] = {
+                Nan::New<Number>((double) worker->bytesCopied)
+            };
+            worker->progress->Call(1, argv, worker->asyncResource);
+        }
+        if (!worker->finished)
+            return;
+        uv_thread_join(&worker->thread);
         Local<v8::Value> argv[] = {
-            Nan::Null()
+            worker->error ? Nan::Error(worker->error) : Nan::Null().As<Value>()
         };
-
-        callback->Call(1, argv, async_resource);
+        worker->callback->Call(1, argv, worker->asyncResource);
+        uv_close((uv_handle_t*) handle, [](uv_handle_t* handle) {
+            CopyWorker* worker = (CopyWorker*) handle->data;
+            delete worker;
+        });
     }
-
-  private:
-    MDBX_env* env;
-    char* path;
-    int flags;
+    EnvWrap* ew;
+    MDBX_copy_flags_t flags;
+    Nan::Callback* callback;
+    Nan::AsyncResource* asyncResource;
+    uv_async_t* events;
+    uv_thread_t thread;
+    uv_file target;
+    uv_file pipeRead;
+    std::atomic<uint64_t> bytesCopied;
+    std::atomic<bool> finished;
+    int pumpError;
+    const char* error;
 };
+
 MDBX_txn* EnvWrap::getReadTxn() {
     MDBX_txn* txn = writeTxn ? writeTxn->txn : nullptr;
     if (txn)
@@ -150,7 +266,7 @@ MDBX_txn* EnvWrap::getReadTxn() {
     if (readTxnRenewed)
         return txn;
     if (txn)
-        mdbx_txn_renew(txn);
+        renewReadTxn(txn);
     else {
         mdbx_txn_begin(env, nullptr, MDBX_TXN_RDONLY, &txn);
         currentReadTxn = txn;
@@ -163,6 +279,30 @@ void cleanup(void* data) {
     ((EnvWrap*) data)->closeEnv();
 }
 
+// called by libmdbx (in a write txn) when there are no free pages to reuse because a reader still holds them
+static int handleSlowReader(const MDBX_env* env, const MDBX_txn* txn, mdbx_pid_t pid, mdbx_tid_t tid, uint64_t laggard,
+        unsigned gap, size_t space, int retry) MDBX_CXX17_NOEXCEPT {
+    SlowReaderPolicy* policy = (SlowReaderPolicy*) mdbx_env_get_userctx(env);
+    if (!policy || retry < 0 || gap < policy->lag)
+        return -1; // grow the database (or fail with MDBX_MAP_FULL)
+    bool kick = policy->action == SLOW_READER_KICK;
+    if (policy->lastReported != laggard || kick) {
+        policy->lastReported = laggard;
+        if (policy->action == SLOW_READER_LOG || kick)
+            fprintf(stderr, "lmdbx: %s reader (pid %u, thread %llu) of txn %llu, which is %u commits behind and retains %llu bytes\n",
+                kick ? "Kicking" : "Slow", (unsigned) pid, (unsigned long long) (uintptr_t) tid, (unsigned long long) laggard,
+                gap, (unsigned long long) space);
+        else {
+            pthread_mutex_lock(&policy->lock);
+            if (policy->pending.size() < 100)
+                policy->pending.push_back({ pid, (uint64_t) (uintptr_t) tid, laggard, gap, space, false });
+            pthread_mutex_unlock(&policy->lock);
+        }
+    }
+    // clearing the reader's slot lets the pages be reused, and the reader must not continue with its snapshot
+    return kick ? 1 : -1;
+}
+
 NAN_METHOD(EnvWrap::open) {
     Nan::HandleScope scope;
 
@@ -187,6 +327,7 @@ NAN_METHOD(EnvWrap::open) {
     if (keyBytesValue->IsArrayBufferView())
         ew->keyBuffer = node::Buffer::Data(keyBytesValue);
     setFlagFromValue(&jsFlags, SEPARATE_FLUSHED, "separateFlushed", false, options);
+    setFlagFromValue(&jsFlags, OVERLAPPING_SYNC, "overlappingSync", false, options);
     ew->jsFlags = jsFlags;
     Local<String> path = Local<String>::Cast(options->Get(Nan::GetCurrentContext(), Nan::New<String>("path").ToLocalChecked()).ToLocalChecked());
     Nan::Utf8String charPath(path);
@@ -197,6 +338,11 @@ NAN_METHOD(EnvWrap::open) {
             envPath.count++;
             mdbx_env_close(ew->env);
             ew->env = envPath.env;
+            // the sync mode of the environment was decided by whoever opened it first
+            if (envPath.overlappingSync)
+                ew->jsFlags |= OVERLAPPING_SYNC;
+            else
+                ew->jsFlags &= ~OVERLAPPING_SYNC;
             pthread_mutex_unlock(envsLock);
             int maxKeySize = mdbx_env_get_maxkeysize_ex(ew->env, MDBX_DB_DEFAULTS);
             info.GetReturnValue().Set(Nan::New<Number>(maxKeySize));
@@ -211,11 +357,20 @@ NAN_METHOD(EnvWrap::open) {
         return throwLmdbxError(rc);
     }
 
-    // Parse the mapSize option
-    Local<Value> mapSizeOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("mapSize").ToLocalChecked()).ToLocalChecked();
-    if (mapSizeOption->IsNumber()) {
-        intptr_t mapSizeSizeT = mapSizeOption->NumberValue(Nan::GetCurrentContext()).FromJust();
-        rc = mdbx_env_set_geometry(ew->env, -1, -1, mapSizeSizeT, -1, -1, -1);
+    // Parse the geometry options (mapSize is the upper bound), any that aren't provided use the libmdbx defaults.
+    // Note that the page size only applies when the database is created.
+    const char* geometryOptions[] = { "minSize", "mapSize", "growthStep", "shrinkThreshold", "pageSize" };
+    intptr_t geometry[] = { -1, -1, -1, -1, -1 };
+    bool hasGeometry = false;
+    for (int i = 0; i < 5; i++) {
+        Local<Value> geometryOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>(geometryOptions[i]).ToLocalChecked()).ToLocalChecked();
+        if (geometryOption->IsNumber()) {
+            geometry[i] = geometryOption->NumberValue(Nan::GetCurrentContext()).FromJust();
+            hasGeometry = true;
+        }
+    }
+    if (hasGeometry) {
+        rc = mdbx_env_set_geometry(ew->env, geometry[0], -1, geometry[1], geometry[2], geometry[3], geometry[4]);
         if (rc != 0) {
             pthread_mutex_unlock(envsLock);
             return throwLmdbxError(rc);
@@ -247,6 +402,13 @@ NAN_METHOD(EnvWrap::open) {
         fprintf(stderr, "You chose to use MDBX_NOLOCK which is not officially supported by node-lmdbx. You have been warned!\n");
     }*/
 
+    // With overlapping sync, commits don't wait for the disk, and the write worker's flush thread syncs them
+    // afterwards (this doesn't apply if we aren't syncing at all)
+    if (flags & (MDBX_SAFE_NOSYNC | MDBX_UTTERLY_NOSYNC))
+        ew->jsFlags &= ~OVERLAPPING_SYNC;
+    else if (ew->jsFlags & OVERLAPPING_SYNC)
+        flags |= MDBX_SAFE_NOSYNC;
+
     // Set MDBX_NOTLS to enable multiple read-only transactions on the same thread (in this case, the nodejs main thread)
     flags |= MDBX_NOTLS;
 
@@ -263,13 +425,48 @@ NAN_METHOD(EnvWrap::open) {
         ew->env = nullptr;
         return throwLmdbxError(rc);
     }
+    if (!(flags & MDBX_RDONLY)) {
+        // Parse the syncBytes and syncPeriod options, for automatically syncing when committing without syncing
+        Local<Value> syncBytesOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("syncBytes").ToLocalChecked()).ToLocalChecked();
+        if (syncBytesOption->IsNumber())
+            rc = mdbx_env_set_option(ew->env, MDBX_opt_sync_bytes, syncBytesOption->IntegerValue(Nan::GetCurrentContext()).FromJust());
+        Local<Value> syncPeriodOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("syncPeriod").ToLocalChecked()).ToLocalChecked();
+        if (rc == 0 && syncPeriodOption->IsNumber()) {
+            // syncPeriod is in milliseconds, libmdbx uses 1/65536ths of a second
+            uint64_t syncPeriod = syncPeriodOption->IntegerValue(Nan::GetCurrentContext()).FromJust();
+            rc = mdbx_env_set_option(ew->env, MDBX_opt_sync_period, syncPeriod * 65536 / 1000);
+            ew->syncPeriod = syncPeriod;
+        }
+        if (rc != 0) {
+            mdbx_env_close(ew->env);
+            pthread_mutex_unlock(envsLock);
+            ew->env = nullptr;
+            return throwLmdbxError(rc);
+        }
+    }
+    Local<Value> slowReaderOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("slowReaderPolicy").ToLocalChecked()).ToLocalChecked();
+    if (slowReaderOption->IsString() && !(flags & MDBX_RDONLY)) {
+        Nan::Utf8String action(slowReaderOption);
+        SlowReaderPolicy* policy = new SlowReaderPolicy();
+        policy->action = !strcmp(*action, "kick") ? SLOW_READER_KICK :
+            !strcmp(*action, "notify") ? SLOW_READER_NOTIFY : SLOW_READER_LOG;
+        Local<Value> lagOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("slowReaderLag").ToLocalChecked()).ToLocalChecked();
+        policy->lag = lagOption->IsNumber() ? lagOption->Uint32Value(Nan::GetCurrentContext()).FromJust() : 0;
+        policy->lastReported = 0;
+        pthread_mutex_init(&policy->lock, nullptr);
+        mdbx_env_set_userctx(ew->env, policy);
+        mdbx_env_set_hsr(ew->env, handleSlowReader);
+    }
     node::AddEnvironmentCleanupHook(Isolate::GetCurrent(), cleanup, ew);
     env_path_t envPath;
     envPath.path = strdup(*charPath);
     envPath.env = ew->env;
     envPath.count = 1;
+    envPath.overlappingSync = ew->jsFlags & OVERLAPPING_SYNC;
     envs.push_back(envPath);
     pthread_mutex_unlock(envsLock);
+    if (ew->syncPeriod)
+        ew->getWriteWorker(); // start the flush thread, so it can sync while we are idle
     int maxKeySize = mdbx_env_get_maxkeysize_ex(ew->env, MDBX_DB_DEFAULTS);
     info.GetReturnValue().Set(Nan::New<Number>(maxKeySize));
 }
@@ -313,6 +510,21 @@ NAN_METHOD(EnvWrap::resize) {
 }
 
 void EnvWrap::closeEnv() {
+    if (writeWorker) {
+        writeWorker->Stop(); // this frees the worker once its event handle is closed
+        writeWorker = nullptr;
+    }
+    if (readPool) {
+        readPool->Stop();
+        readPool = nullptr;
+    }
+    for (ScanWorker* scan : scans)
+        scan->Stop();
+    scans.clear();
+    // queued compression jobs still reference this environment, cancel them and wait for them to be popped
+    compressionCancelled = true;
+    while (compressionJobs.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
     cleanupStrayTxns();
 
     pthread_mutex_lock(envsLock);
@@ -322,7 +534,12 @@ void EnvWrap::closeEnv() {
             if (envPath->count <= 0) {
                 // last thread using it, we can really close it now
                 envs.erase(envPath);
+                SlowReaderPolicy* policy = (SlowReaderPolicy*) mdbx_env_get_userctx(env);
                 mdbx_env_close(env);
+                if (policy) {
+                    pthread_mutex_destroy(&policy->lock);
+                    delete policy;
+                }
             }
             break;
         }
@@ -454,14 +671,24 @@ NAN_METHOD(EnvWrap::readerCheck) {
     info.GetReturnValue().Set(Nan::New<Number>(dead));
 }
 
-/*Local<Array> readerStrings;
-MDBX_msg_func* printReaders = ([](const char* message, void* ctx) -> int {
-    readerStrings->Set(Nan::GetCurrentContext(), readerStrings->Length(), Nan::New<String>(message).ToLocalChecked()).ToChecked();
+struct ReaderEntry {
+    int slot;
+    mdbx_pid_t pid;
+    uint64_t tid;
+    uint64_t txnId;
+    uint64_t lag;
+    size_t usedSize;
+    size_t retainedSize;
+};
+
+static int collectReader(void* ctx, int num, int slot, mdbx_pid_t pid, mdbx_tid_t thread, uint64_t txnid,
+        uint64_t lag, size_t bytesUsed, size_t bytesRetained) MDBX_CXX17_NOEXCEPT {
+    ((std::vector<ReaderEntry>*) ctx)->push_back({ slot, pid, (uint64_t) (uintptr_t) thread, txnid, lag, bytesUsed, bytesRetained });
     return 0;
-});*/
+}
 
 NAN_METHOD(EnvWrap::readerList) {
-    /*Nan::HandleScope scope;
+    Nan::HandleScope scope;
 
     // Get the wrapper
     EnvWrap* ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
@@ -469,18 +696,58 @@ NAN_METHOD(EnvWrap::readerList) {
         return Nan::ThrowError("The environment is already closed.");
     }
 
-    readerStrings = Nan::New<Array>(0);
-    int rc;
-    rc = mdbx_reader_list(ew->env, printReaders, nullptr);
-    if (rc != 0) {
+    std::vector<ReaderEntry> readers;
+    int rc = mdbx_reader_list(ew->env, collectReader, &readers);
+    if (rc != 0 && rc != MDBX_RESULT_TRUE) {
         return throwLmdbxError(rc);
     }
-    info.GetReturnValue().Set(readerStrings);*/
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Array> list = Nan::New<Array>(readers.size());
+    for (unsigned i = 0; i < readers.size(); i++) {
+        ReaderEntry& reader = readers[i];
+        Local<Object> obj = Nan::New<Object>();
+        (void)obj->Set(context, Nan::New<String>("slot").ToLocalChecked(), Nan::New<Number>(reader.slot));
+        (void)obj->Set(context, Nan::New<String>("pid").ToLocalChecked(), Nan::New<Number>(reader.pid));
+        (void)obj->Set(context, Nan::New<String>("thread").ToLocalChecked(), Nan::New<Number>((double) reader.tid));
+        // a txn id of 0 is an idle (reset) reader
+        (void)obj->Set(context, Nan::New<String>("txnId").ToLocalChecked(), Nan::New<Number>((double) reader.txnId));
+        (void)obj->Set(context, Nan::New<String>("lag").ToLocalChecked(), Nan::New<Number>((double) reader.lag));
+        (void)obj->Set(context, Nan::New<String>("usedSize").ToLocalChecked(), Nan::New<Number>((double) reader.usedSize));
+        (void)obj->Set(context, Nan::New<String>("retainedSize").ToLocalChecked(), Nan::New<Number>((double) reader.retainedSize));
+        (void)list->Set(context, i, obj);
+    }
+    info.GetReturnValue().Set(list);
+}
+
+NAN_METHOD(EnvWrap::takeSlowReaders) {
+    EnvWrap* ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
+    SlowReaderPolicy* policy = ew->env ? (SlowReaderPolicy*) mdbx_env_get_userctx(ew->env) : nullptr;
+    if (!policy)
+        return;
+    std::vector<SlowReader> readers;
+    pthread_mutex_lock(&policy->lock);
+    readers.swap(policy->pending);
+    pthread_mutex_unlock(&policy->lock);
+    if (readers.empty())
+        return;
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Array> list = Nan::New<Array>(readers.size());
+    for (unsigned i = 0; i < readers.size(); i++) {
+        SlowReader& reader = readers[i];
+        Local<Object> obj = Nan::New<Object>();
+        (void)obj->Set(context, Nan::New<String>("pid").ToLocalChecked(), Nan::New<Number>(reader.pid));
+        (void)obj->Set(context, Nan::New<String>("thread").ToLocalChecked(), Nan::New<Number>((double) reader.tid));
+        (void)obj->Set(context, Nan::New<String>("txnId").ToLocalChecked(), Nan::New<Number>((double) reader.txnId));
+        (void)obj->Set(context, Nan::New<String>("lag").ToLocalChecked(), Nan::New<Number>(reader.lag));
+        (void)obj->Set(context, Nan::New<String>("retainedSize").ToLocalChecked(), Nan::New<Number>((double) reader.retainedSize));
+        (void)list->Set(context, i, obj);
+    }
+    info.GetReturnValue().Set(list);
 }
 
 
 NAN_METHOD(EnvWrap::copy) {
-    /*Nan::HandleScope scope;
+    Nan::HandleScope scope;
 
     // Get the wrapper
     EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
@@ -490,28 +757,40 @@ NAN_METHOD(EnvWrap::copy) {
     }
 
     // Check that the correct number/type of arguments was given.
-    if (!info[0]->IsString()) {
-        return Nan::ThrowError("Call env.copy(path, compact?, callback) with a file path.");
-    }
-    if (!info[info.Length() - 1]->IsFunction()) {
-        return Nan::ThrowError("Call env.copy(path, compact?, callback) with a file path.");
+    if (!(info[0]->IsString() || info[0]->IsNumber()) || !info[info.Length() - 1]->IsFunction()) {
+        return Nan::ThrowError("Call env.copy(pathOrFd, options?, callback) with a file path or file descriptor.");
     }
-    Nan::Utf8String path(info[0].As<String>());
 
-    int flags = 0;
-    if (info.Length() > 1 && info[1]->IsTrue()) {
+    MDBX_copy_flags_t flags = MDBX_CP_DEFAULTS;
+    double bytesPerSecond = 0;
+    Nan::Callback* progress = nullptr;
+    if (info.Length() > 2 && info[1]->IsObject()) {
+        Local<Object> options = Local<Object>::Cast(info[1]);
+        setFlagFromValue((int*) &flags, (int) MDBX_CP_COMPACT, "compact", false, options);
+        setFlagFromValue((int*) &flags, (int) MDBX_CP_FORCE_DYNAMIC_SIZE, "forceDynamicSize", false, options);
+        Local<Value> bytesPerSecondOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("bytesPerSecond").ToLocalChecked()).ToLocalChecked();
+        if (bytesPerSecondOption->IsNumber())
+            bytesPerSecond = bytesPerSecondOption->NumberValue(Nan::GetCurrentContext()).FromJust();
+        Local<Value> progressOption = options->Get(Nan::GetCurrentContext(), Nan::New<String>("progress").ToLocalChecked()).ToLocalChecked();
+        if (progressOption->IsFunction())
+            progress = new Nan::Callback(Local<v8::Function>::Cast(progressOption));
+    } else if (info.Length() > 2 && info[1]->IsTrue()) {
         flags = MDBX_CP_COMPACT;
     }
 
     Nan::Callback* callback = new Nan::Callback(
-      Local<v8::Function>::Cast(info[info.Length()  > 2 ? 2 : 1])
+      Local<v8::Function>::Cast(info[info.Length() - 1])
     );
 
-    CopyWorker* worker = new CopyWorker(
-      ew->env, *path, flags, callback
-    );
-
-    Nan::AsyncQueueWorker(worker);*/
+    CopyWorker* worker = new CopyWorker(ew, flags, callback);
+    if (info[0]->IsString()) {
+        Nan::Utf8String path(info[0].As<String>());
+        worker->path = strdup(*path);
+    } else
+        worker->fd = info[0]->IntegerValue(Nan::GetCurrentContext()).FromJust();
+    worker->bytesPerSecond = bytesPerSecond;
+    worker->progress = progress;
+    worker->Start();
 }
 
 NAN_METHOD(EnvWrap::detachBuffer) {
@@ -561,7 +840,7 @@ NAN_METHOD(EnvWrap::beginTxn) {
             }
         } else {
             mdbx_txn_begin(env, nullptr, (MDBX_txn_flags_t)(flags & 0xf0000), &txn);
-            flags |= TXN_ABORTABLE;
+            flags |= TXN_ABORTABLE | TXN_NOT_NESTED;
         }
         ew->writeTxn = new TxnTracked(txn, flags);
         return;
@@ -601,6 +880,14 @@ NAN_METHOD(EnvWrap::commitTxn) {
         rc = mdbx_txn_commit(currentTxn->txn);
     }
     ew->writeTxn = currentTxn->parent;
+    if (rc == 0 && !ew->writeTxn && (currentTxn->flags & TXN_INTERRUPTED_BATCH)) {
+        // this ran nested in the paused batch's txn, commit that now (the write thread starts a new one)
+        WriteWorker* writeWorker = ew->writeWorker;
+        rc = mdbx_txn_commit(writeWorker->txn);
+        if (rc) // the writes of the batch before the interruption are lost, so the batch must fail too
+            writeWorker->interruptedBatchError = rc;
+        writeWorker->txn = nullptr;
+    }
     if (!ew->writeTxn) {
         //fprintf(stderr, "unlock txn\n");
         if (ew->writeWorker)
@@ -608,6 +895,12 @@ NAN_METHOD(EnvWrap::commitTxn) {
         else
             pthread_mutex_unlock(ew->writingLock);
     }
+    if (rc == 0 && (currentTxn->flags & (TXN_NOT_NESTED | TXN_INTERRUPTED_BATCH)) && (ew->jsFlags & OVERLAPPING_SYNC)) {
+        // synchronous transactions are still expected to be durable when they return
+        rc = mdbx_env_sync_ex(ew->env, true, false);
+        if (rc == MDBX_RESULT_TRUE)
+            rc = 0;
+    }
     delete currentTxn;
     if (rc)
         throwLmdbxError(rc);
@@ -664,12 +957,23 @@ NAN_METHOD(EnvWrap::sync) {
       Local<v8::Function>::Cast(info[0])
     );
 
-    SyncWorker* worker = new SyncWorker(
-      ew->env, callback
-    );
+    ew->getWriteWorker()->Sync(callback);
+}
 
-    Nan::AsyncQueueWorker(worker);
-    return;
+WriteWorker* EnvWrap::getWriteWorker() {
+    if (!writeWorker) {
+        writeWorker = new WriteWorker(env, this);
+        writeWorker->Start();
+    }
+    return writeWorker;
+}
+
+ReadPool* EnvWrap::getReadPool() {
+    if (!readPool) {
+        readPool = new ReadPool(env);
+        readPool->Start(READ_THREADS);
+    }
+    return readPool;
 }
 
 NAN_METHOD(EnvWrap::resetCurrentReadTxn) {
@@ -694,11 +998,13 @@ void EnvWrap::setupExports(Local<Object> exports) {
     envTpl->PrototypeTemplate()->Set(isolate, "sync", Nan::New<FunctionTemplate>(EnvWrap::sync));
     envTpl->PrototypeTemplate()->Set(isolate, "startWriting", Nan::New<FunctionTemplate>(EnvWrap::startWriting));
     envTpl->PrototypeTemplate()->Set(isolate, "compress", Nan::New<FunctionTemplate>(EnvWrap::compress));
+    envTpl->PrototypeTemplate()->Set(isolate, "takeWriteResult", Nan::New<FunctionTemplate>(EnvWrap::takeWriteResult));
     envTpl->PrototypeTemplate()->Set(isolate, "stat", Nan::New<FunctionTemplate>(EnvWrap::stat));
     envTpl->PrototypeTemplate()->Set(isolate, "freeStat", Nan::New<FunctionTemplate>(EnvWrap::freeStat));
     envTpl->PrototypeTemplate()->Set(isolate, "info", Nan::New<FunctionTemplate>(EnvWrap::info));
     envTpl->PrototypeTemplate()->Set(isolate, "readerCheck", Nan::New<FunctionTemplate>(EnvWrap::readerCheck));
     envTpl->PrototypeTemplate()->Set(isolate, "readerList", Nan::New<FunctionTemplate>(EnvWrap::readerList));
+    envTpl->PrototypeTemplate()->Set(isolate, "takeSlowReaders", Nan::New<FunctionTemplate>(EnvWrap::takeSlowReaders));
     envTpl->PrototypeTemplate()->Set(isolate, "resize", Nan::New<FunctionTemplate>(EnvWrap::resize));
     envTpl->PrototypeTemplate()->Set(isolate, "copy", Nan::New<FunctionTemplate>(EnvWrap::copy));
     envTpl->PrototypeTemplate()->Set(isolate, "detachBuffer", Nan::New<FunctionTemplate>(EnvWrap::detachBuffer));
@@ -713,6 +1019,8 @@ void EnvWrap::setupExports(Local<Object> exports) {
     txnTpl->PrototypeTemplate()->Set(isolate, "abort", Nan::New<FunctionTemplate>(TxnWrap::abort));
     txnTpl->PrototypeTemplate()->Set(isolate, "reset", Nan::New<FunctionTemplate>(TxnWrap::reset));
     txnTpl->PrototypeTemplate()->Set(isolate, "renew", Nan::New<FunctionTemplate>(TxnWrap::renew));
+    txnTpl->PrototypeTemplate()->Set(isolate, "use", Nan::New<FunctionTemplate>(TxnWrap::use));
+    txnTpl->PrototypeTemplate()->Set(isolate, "info", Nan::New<FunctionTemplate>(TxnWrap::info));
     // TODO: wrap mdbx_cmp too
     // TODO: wrap mdbx_dcmp too
     // TxnWrap: Get constructor
@@ -726,6 +1034,10 @@ void EnvWrap::setupExports(Local<Object> exports) {
     // DbiWrap: Add functions to the prototype
     dbiTpl->PrototypeTemplate()->Set(isolate, "close", Nan::New<FunctionTemplate>(DbiWrap::close));
     dbiTpl->PrototypeTemplate()->Set(isolate, "drop", Nan::New<FunctionTemplate>(DbiWrap::drop));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "getMany", Nan::New<FunctionTemplate>(DbiWrap::getMany));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "getManyAsync", Nan::New<FunctionTemplate>(DbiWrap::getManyAsync));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "getPartitions", Nan::New<FunctionTemplate>(DbiWrap::getPartitions));
+    dbiTpl->PrototypeTemplate()->Set(isolate, "scanParallel", Nan::New<FunctionTemplate>(DbiWrap::scanParallel));
     dbiTpl->PrototypeTemplate()->Set(isolate, "stat", Nan::New<FunctionTemplate>(DbiWrap::stat));
     #if ENABLE_FAST_API && NODE_VERSION_AT_LEAST(16,6,0)
     auto getFast = CFunction::Make(DbiWrap::getByBinaryFast);
@@ -762,6 +1074,8 @@ void EnvWrap::setupExports(Local<Object> exports) {
     compressionTpl->SetClassName(Nan::New<String>("Compression").ToLocalChecked());
     compressionTpl->InstanceTemplate()->SetInternalFieldCount(1);
     compressionTpl->PrototypeTemplate()->Set(isolate, "setBuffer", Nan::New<FunctionTemplate>(Compression::setBuffer));
+    compressionTpl->PrototypeTemplate()->Set(isolate, "addDictionary", Nan::New<FunctionTemplate>(Compression::addDictionary));
+    compressionTpl->PrototypeTemplate()->Set(isolate, "takeLastCompression", Nan::New<FunctionTemplate>(Compression::takeLastCompression));
     (void)exports->Set(Nan::GetCurrentContext(), Nan::New<String>("Compression").ToLocalChecked(), compressionTpl->GetFunction(Nan::GetCurrentContext()).ToLocalChecked());
 
     // Set exports
@@ -25,6 +25,9 @@
 #define NODE_LMDBX_H
 
 #include <vector>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
 #include <algorithm>
 #include <v8.h>
 #include <node.h>
@@ -79,6 +82,9 @@ int pthread_cond_broadcast(pthread_cond_t *cond);
 #endif
 
 int cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, uint64_t ns);
+// wait while the 32-bit word at address still holds the expected value, and wake any such waiters
+int futex_wait(uint32_t* address, uint32_t expected);
+void futex_wake(uint32_t* address);
 
 #endif /* __CPTHREAD_H__ */
 
@@ -132,7 +138,19 @@ void setFlagFromValue(int *flags, int flag, const char *name, bool defaultValue,
 void writeValueToEntry(const Local<Value> &str, MDBX_val *val);
 NodeLmdbxKeyType keyTypeFromOptions(const Local<Value> &val, NodeLmdbxKeyType defaultKeyType = NodeLmdbxKeyType::DefaultKey);
 bool getVersionAndUncompress(MDBX_val &data, DbiWrap* dw);
+// parses a block of size prefixed keys, and determines the order to visit them in (sorted unless already sorted)
+void getManyKeyOrder(MDBX_txn* txn, MDBX_dbi dbi, char* keyBlock, uint32_t count, bool sorted,
+    std::vector<MDBX_val>& keys, std::vector<uint32_t>& order);
+/*
+    Packs an entry into the target at the given position, as a record of the key size, value size, version (if versioned
+    with values), key and (uncompressed) value. Returns the end of the record, padded to an 8-byte boundary, and sets
+    whether it fit in the target (nothing is written if it doesn't), or returns 0 if the value could not be decompressed.
+*/
+size_t packEntry(char* target, size_t targetSize, size_t position, MDBX_val &key, MDBX_val &data,
+    bool includeValues, bool hasVersions, Compression* compression, bool &fits);
 int compareFast(const MDBX_val *a, const MDBX_val *b);
+// renews a read txn, unless it is still active and nothing has been committed since its snapshot was taken
+int renewReadTxn(MDBX_txn* txn);
 NAN_METHOD(setGlobalBuffer);
 NAN_METHOD(lmdbxError);
 //NAN_METHOD(getBufferForAddress);
@@ -174,6 +192,8 @@ struct env_path_t {
     MDBX_env* env;
     char* path;
     int count;
+    // whether the environment was opened to commit without syncing, and flush afterwards
+    bool overlappingSync;
 };
 
 const int INTERRUPT_BATCH = 9998;
@@ -182,28 +202,111 @@ const int RESTART_WORKER_TXN = 9999;
 const int RESUME_BATCH = 9996;
 const int USER_HAS_LOCK = 9995;
 const int SEPARATE_FLUSHED = 1;
+const int OVERLAPPING_SYNC = 2;
+const int GET_MANY_SORTED = 1;
+const int GET_MANY_EXISTS_ONLY = 2;
+
+// a reader that was holding back page reuse when the database had no free pages left
+struct SlowReader {
+    mdbx_pid_t pid;
+    uint64_t tid;
+    uint64_t txnId;
+    unsigned lag;
+    size_t retainedSize;
+    bool kicked;
+};
+const int SLOW_READER_LOG = 1;
+const int SLOW_READER_KICK = 2;
+const int SLOW_READER_NOTIFY = 3;
+/*
+    What to do about readers that prevent freed pages from being reused (set as the handle-slow-readers callback of the
+    environment, with this as its user context). This belongs to the environment and lives until it is closed.
+*/
+struct SlowReaderPolicy {
+    int action;
+    // readers that lag fewer commits than this are left alone
+    unsigned lag;
+    // only report each stuck snapshot once
+    uint64_t lastReported;
+    pthread_mutex_t lock;
+    // reports waiting for JS to take them
+    std::vector<SlowReader> pending;
+};
 
-class WriteWorker : public Nan::AsyncProgressWorker {
+struct WriteEvent {
+    int status;
+    const char* error;
+    Nan::Callback* callback;
+    // for sync requests, the last transaction id that is known to be durable
+    uint64_t txnId;
+};
+
+struct WriteBatch {
+    uint32_t* instructions;
+    Nan::Callback* callback;
+    const char* error;
+    // a flush requested by env.sync() rather than by a commit
+    bool syncRequest;
+};
+
+/*
+    The long-lived write thread for an environment. It consumes batches of write instructions, one
+    transaction per batch, parking on the instruction words while it waits for more instructions, and
+    reports progress and commits back to the JS thread through a single uv_async handle. With overlapping
+    sync, commits are made durable afterwards by a second (flush) thread, so the next batch doesn't wait on
+    the disk.
+*/
+class WriteWorker {
   public:
-    WriteWorker(MDBX_env* env, EnvWrap* envForTxn, uint32_t* instructions, Nan::Callback *callback);
+    WriteWorker(MDBX_env* env, EnvWrap* envForTxn);
+    ~WriteWorker();
+    void Start();
+    void Stop();
+    void Enqueue(uint32_t* instructions, Nan::Callback* callback);
     void Write();
     MDBX_txn* txn;
     MDBX_txn* AcquireTxn(int* flags);
     void UnlockTxn();
-    void Execute(const ExecutionProgress& executionProgress);
-    void HandleProgressCallback(const char* data, size_t count);
-    void HandleOKCallback();
+    void Notify();
+    void SendEvent(int status, const char* error, Nan::Callback* callback, uint64_t txnId = 0);
+    void RequestFlush(uint32_t* instructions, Nan::Callback* callback, const char* error);
+    void Sync(Nan::Callback* callback);
+    void HandleProgressCallback(Nan::Callback* callback);
     int WaitForCallbacks(MDBX_txn** txn, bool allowCommit, uint32_t* target);
     void ReportError(const char* error);
     int interruptionStatus;
+    // set when committing the txn of an interrupted batch fails, so the batch fails when it resumes
+    int interruptedBatchError;
     bool finishedProgress;
+    bool closing;
     EnvWrap* envForTxn;
-    ~WriteWorker();
     uint32_t* instructions;
+    // callback for the batch that is currently being written
+    Nan::Callback* callback;
+    // instruction word that the write thread is currently parked on, if any
+    uint32_t* waitingOn;
     int progressStatus;
   private:
-    ExecutionProgress* executionProgress;
+    static void Run(void* worker);
+    static void Flush(void* worker);
+    static void HandleEvents(uv_async_t* handle);
     MDBX_env* env;
+    uv_thread_t thread;
+    uv_thread_t flushThread;
+    uv_async_t* events;
+    Nan::AsyncResource* asyncResource;
+    // guards the batch and flush queues and the pending events
+    pthread_mutex_t queueLock;
+    pthread_cond_t queueCond;
+    pthread_cond_t flushCond;
+    std::deque<WriteBatch> batches;
+    std::vector<WriteBatch> flushes;
+    std::vector<WriteEvent> pendingEvents;
+    // set once the write thread has exited, so the flush thread can finish
+    bool writerStopped;
+    // number of batches that haven't been finished, only accessed from the JS thread
+    int outstandingBatches;
+    const char* errorMessage;
 };
 
 class TxnTracked {
@@ -222,6 +325,107 @@ class TxnTracked {
     Represents a database environment.
     (Wrapper for `MDBX_env`)
 */
+const unsigned int READ_THREADS = 4;
+
+struct ReadJob {
+    EnvWrap* ew;
+    MDBX_dbi dbi;
+    bool hasVersions;
+    Compression* compression;
+    char* keys;
+    uint32_t count;
+    int flags;
+    Nan::Callback* callback;
+    // result block, in the same format as DbiWrap::getMany (handed over to a JS buffer when delivered)
+    char* result;
+    size_t resultSize;
+    const char* error;
+    void Run(MDBX_txn* txn);
+};
+
+/*
+    A small pool of threads for an environment that perform reads off the JS thread, so page faults on cold data
+    don't block the event loop. Each thread has its own read transaction, which is renewed for each job, and
+    results are delivered back to the JS thread through a single uv_async handle.
+*/
+class ReadPool {
+  public:
+    ReadPool(MDBX_env* env);
+    ~ReadPool();
+    void Start(unsigned int threads);
+    // finishes any queued reads and stops the threads, the pool deletes itself once the results are delivered
+    void Stop();
+    void Enqueue(ReadJob* job);
+  private:
+    static void Run(void* pool);
+    static void HandleEvents(uv_async_t* handle);
+    void Deliver();
+    MDBX_env* env;
+    std::vector<uv_thread_t> threads;
+    uv_async_t* events;
+    Nan::AsyncResource* asyncResource;
+    pthread_mutex_t queueLock;
+    pthread_cond_t queueCond;
+    std::deque<ReadJob*> jobs;
+    std::deque<ReadJob*> completed;
+    bool stopping;
+    // number of jobs that haven't been delivered, only accessed from the JS thread
+    int outstandingJobs;
+};
+
+const size_t SCAN_BLOCK_SIZE = 0x40000;
+
+struct ScanBlock {
+    int partition;
+    char* data;
+    size_t size;
+    uint32_t count;
+    // the last block for this partition
+    bool done;
+    const char* error;
+};
+
+/*
+    Scans a range in parallel, with one thread per partition of the range. Each thread has its own read transaction,
+    and all of them are started on the same snapshot. Entries are packed into blocks (in the same format as
+    CursorWrap::iterateBatch) that are streamed back to the JS thread, and the threads wait if too many blocks are
+    waiting to be delivered.
+*/
+class ScanWorker {
+  public:
+    ScanWorker(DbiWrap* dw, Nan::Callback* callback, bool includeValues);
+    ~ScanWorker();
+    // starts a thread for each partition, with the bounds given as a block of size prefixed keys (empty for open ended)
+    const char* Start(char* boundsBlock, uint32_t partitions);
+    // stops the threads (the remaining partitions end with an error) and waits for them, for closing the environment
+    void Stop();
+  private:
+    static void Run(void* data);
+    static void HandleEvents(uv_async_t* handle);
+    void Send(ScanBlock block);
+    void Deliver();
+    EnvWrap* ew;
+    MDBX_dbi dbi;
+    bool includeValues;
+    bool hasVersions;
+    Compression* compression;
+    Nan::Callback* callback;
+    Nan::AsyncResource* asyncResource;
+    uv_async_t* events;
+    std::vector<uv_thread_t> threads;
+    std::vector<MDBX_txn*> txns;
+    std::vector<MDBX_val> bounds;
+    char* boundsBlock;
+    pthread_mutex_t queueLock;
+    pthread_cond_t queueCond;
+    std::deque<ScanBlock> blocks;
+    // number of blocks that have been sent, but not delivered
+    unsigned int pendingBlocks;
+    unsigned int finishedPartitions;
+    std::atomic<bool> stopping;
+    friend struct ScanPartition;
+};
+
 class EnvWrap : public Nan::ObjectWrap {
 private:
     // List of open read transactions
@@ -241,6 +445,9 @@ private:
 
     friend class TxnWrap;
     friend class DbiWrap;
+    friend class CopyWorker;
+    friend class ReadPool;
+    friend class ScanWorker;
 
 public:
     EnvWrap();
@@ -255,10 +462,23 @@ public:
 
     MDBX_txn* currentReadTxn;
     WriteWorker* writeWorker;
+    ReadPool* readPool;
+    // parallel scans that are running, their threads hold read transactions that must end before the environment closes
+    std::vector<ScanWorker*> scans;
     bool readTxnRenewed;
+    // compression jobs that have been queued for this environment's instructions and not popped yet, these
+    // must all be popped before the environment is closed (they are skipped once compression is cancelled)
+    std::atomic<int> compressionJobs;
+    std::atomic<bool> compressionCancelled;
     unsigned int jsFlags;
+    // interval (in milliseconds) for the flush thread to check if a sync is due, 0 if disabled
+    unsigned int syncPeriod;
     char* keyBuffer;
     MDBX_txn* getReadTxn();
+    // gets the write worker for this environment, starting it if necessary
+    WriteWorker* getWriteWorker();
+    // gets the reader pool for this environment, starting it if necessary
+    ReadPool* getReadPool();
 
     // Sets up exports for the Env constructor
     static void setupExports(Local<Object> exports);
@@ -297,6 +517,10 @@ public:
         Print a list of readers
     */
     static NAN_METHOD(readerList);
+    /*
+        Returns the slow readers that were reported since the last call (with the notify slow reader policy)
+    */
+    static NAN_METHOD(takeSlowReaders);
 
     /*
         Opens the database environment with the specified options. The options will be used to configure the environment before opening it.
@@ -326,14 +550,15 @@ public:
     static NAN_METHOD(resize);
 
     /*
-        Copies the database environment to a file.
-        (Wrapper for `mdbx_env_copy2`)
+        Copies the database environment to a file, or to a file descriptor (which may be a pipe).
+        (Wrapper for `mdbx_env_copy` and `mdbx_env_copy2fd`)
 
         Parameters:
 
-        * path - Path to the target file
-        * compact (optional) - Copy using compact setting
-        * callback - Callback when finished (this is performed asynchronously)
+        * path or fd - Path to the target file (which must not exist), or a file descriptor
+        * options (optional) - An object with compact, forceDynamicSize, bytesPerSecond (a limit on the copy rate)
+          and progress (a callback with the number of bytes copied) properties, or true to copy using compaction
+        * callback - Callback when finished (this is performed asynchronously, on its own thread)
     */
     static NAN_METHOD(copy);    
 
@@ -381,12 +606,14 @@ public:
     static NAN_METHOD(openDbi);
 
     /*
-        Flushes all data to the disk asynchronously.
-        (Asynchronous wrapper for `mdbx_env_sync`)
+        Flushes all data to the disk asynchronously, on the write worker's flush thread. Concurrent calls
+        are coalesced into a single flush.
+        (Asynchronous wrapper for `mdbx_env_sync_ex`)
 
         Parameters:
 
-        * Callback to be executed after the sync is complete.
+        * Callback to be executed after the sync is complete, with an error or the id of the last
+          transaction that is durable.
     */
     static NAN_METHOD(sync);
 
@@ -404,12 +631,25 @@ public:
 #endif
     static void write(const v8::FunctionCallbackInfo<v8::Value>& info);
 
+    /*
+        Takes ownership of the previous value that the write thread left in the value slot of a get-and-set merge
+        instruction, returning it as a buffer (or null if there was no previous value)
+
+        Parameters:
+
+        * The address of the value slot of the instruction
+    */
+    static NAN_METHOD(takeWriteResult);
+
     static NAN_METHOD(resetCurrentReadTxn);
 };
 
 const int TXN_ABORTABLE = 1;
 const int TXN_SYNCHRONOUS_COMMIT = 2;
 const int TXN_FROM_WORKER = 4;
+const int TXN_NOT_NESTED = 8;
+// a synchronous transaction nested in a paused batch, the batch's txn is committed along with it
+const int TXN_INTERRUPTED_BATCH = 16;
 
 /*
     `Txn`
@@ -471,6 +711,21 @@ public:
     */
     static NAN_METHOD(renew);
 
+    /*
+        Makes this the read txn that reads are performed in, for a pinned snapshot.
+
+        Parameters:
+
+        * Whether the txn is active (renewed)
+    */
+    static NAN_METHOD(use);
+
+    /*
+        Returns the txn id, how many commits the snapshot lags behind, and the size of the pages retained by it.
+        (Wrapper for `mdbx_txn_info`)
+    */
+    static NAN_METHOD(info);
+
 };
 
 /*
@@ -535,6 +790,100 @@ public:
 #endif
     static void getByBinary(const v8::FunctionCallbackInfo<v8::Value>& info);
     static NAN_METHOD(getStringByBinary);
+    /*
+        Gets the values for a block of keys with a single cursor, visiting the keys in sorted order.
+
+        Parameters:
+
+        * Buffer with the 32-bit size prefixed keys
+        * Number of keys
+        * Target buffer for the results
+        * Flags (GET_MANY_SORTED if the keys are already in order, GET_MANY_EXISTS_ONLY to only check existence)
+    */
+    static NAN_METHOD(getMany);
+    /*
+        Gets the values for a block of keys on the reader pool, calling back with a buffer of the results (in the
+        same format as getMany).
+
+        Parameters:
+
+        * Buffer with the 32-bit size prefixed keys
+        * Size of the key block
+        * Number of keys
+        * Flags
+        * Callback
+    */
+    static NAN_METHOD(getManyAsync);
+    /*
+        Finds keys that split a range into partitions with roughly the same number of entries, using estimates of the
+        range sizes (by bisecting the key space). Returns an array of the split keys (each an actual key in the database),
+        which may be fewer than requested for small ranges.
+
+        Parameters:
+
+        * Buffer with the size prefixed start and end keys (empty for open ended)
+        * Number of partitions
+    */
+    static NAN_METHOD(getPartitions);
+    /*
+        Scans the partitions of a range on separate threads, with a consistent snapshot.
+
+        Parameters:
+
+        * Buffer with the size prefixed bounds of the partitions (number of partitions + 1, empty for open ended)
+        * Size of the bounds block
+        * Number of partitions
+        * Whether to include values
+        * Callback, called with (error, partition, buffer, count, done) for each block of entries
+    */
+    static NAN_METHOD(scanParallel);
+};
+
+/*
+    A byte-bounded cache of decompressed values, keyed by the address of the compressed bytes in the memory map.
+    Each entry keeps a copy of the compressed bytes, so an address that a later commit has reused (or a value that
+    was changed in place in a write txn) is detected by comparison and replaced. Entries are evicted with CLOCK.
+    It is shared by the JS thread and the threads that read (or scan) ranges, so it is guarded by a mutex.
+*/
+class DecompressedCache {
+public:
+    DecompressedCache(size_t maxBytes);
+    ~DecompressedCache();
+    // copies a cached value for the given compressed bytes into the target, returning false if it isn't cached
+    bool get(const char* compressed, uint32_t compressedLength, char* target, uint32_t length);
+    void put(const char* compressed, uint32_t compressedLength, const char* decompressed, uint32_t length);
+private:
+    struct Entry {
+        const char* address;
+        uint32_t compressedLength;
+        uint32_t length;
+        // the compressed bytes followed by the decompressed bytes, nullptr for an empty slot
+        char* bytes;
+        bool referenced;
+    };
+    void evict(size_t slot);
+    std::vector<Entry> entries;
+    std::vector<size_t> freeSlots;
+    std::unordered_map<const char*, size_t> slots;
+    size_t maxBytes;
+    size_t bytes;
+    size_t hand;
+    pthread_mutex_t lock;
+};
+
+/*
+    A compression codec, identified by its index in the codec table, which is recorded in the extended header of the
+    values it compresses. The functions can be called from any thread, and take a dictionary (which may be empty).
+*/
+struct CompressionCodec {
+    const char* name;
+    int (*compressBound)(int size);
+    // returns the compressed size, or 0 if it failed
+    int (*compress)(const char* source, char* target, int sourceSize, int targetCapacity,
+        const char* dictionary, int dictionarySize, int level);
+    // returns the decompressed size, or a negative number if the data is invalid
+    int (*decompress)(const char* source, char* target, int compressedSize, int uncompressedSize,
+        const char* dictionary, int dictionarySize);
 };
 
 class Compression : public Nan::ObjectWrap {
@@ -546,12 +895,44 @@ public:
     unsigned int compressionThreshold;
     // compression acceleration (defaults to 1)
     int acceleration;
+    // the codec new values are compressed with, and its compression level (for codecs that have levels)
+    int codec;
+    int level;
     static thread_local LZ4_stream_t* stream;
+    // optional cache of decompressed values for frequently read entries
+    DecompressedCache* cache;
     void decompress(MDBX_val& data, bool &isValid, bool canAllocate);
+    // a copy of the dictionary that isn't moved when the decompression buffer is reallocated, for use off the JS thread
+    char* stableDictionary;
+    unsigned int stableDictionarySize;
+    // trained dictionaries by version (1-255), these are only ever added, and the newest is used to compress new values.
+    // They are read by the compression and reader threads, so a dictionary is published with a release store after
+    // its size, and is never replaced or freed while the Compression exists
+    std::atomic<char*> dictionaries[256];
+    unsigned int dictionarySizes[256];
+    std::atomic<int> dictionaryVersion;
+    // the codec (shifted by 8) and dictionary version of the last decompressed value (-1 if there hasn't been
+    // one since it was last taken)
+    int lastCompression;
+    /*
+        Decompresses into the given target, from any thread. Returns the uncompressed length (without decompressing
+        if it is larger than the target size), or -1 if the data is invalid.
+    */
+    int64_t decompressTo(MDBX_val& data, char* target, size_t targetSize);
     argtokey_callback_t compress(MDBX_val* value, argtokey_callback_t freeValue);
     int compressInstruction(EnvWrap* env, double* compressionAddress);
+    // starts (or grows) the process-wide pool of threads that compress queued write instructions
+    static void startThreads(unsigned int threads);
     static NAN_METHOD(ctor);
     static NAN_METHOD(setBuffer);
+    /*
+        Adds a trained dictionary, which becomes the dictionary for new values if it is the newest version.
+        * Dictionary version (1-255)
+        * Dictionary buffer (copied)
+    */
+    static NAN_METHOD(addDictionary);
+    // Returns the codec (shifted by 8) and dictionary version of the last decompressed value, and resets it
+    static NAN_METHOD(takeLastCompression);
     Compression();
     ~Compression();
     friend class EnvWrap;
@@ -580,6 +961,10 @@ private:
     int flags;
     DbiWrap *dw;
     MDBX_txn *txn;
+    // the id of the snapshot the cursor was last bound to, it only needs to be renewed when this changes
+    uint64_t txnId;
+    // the entry the cursor is on didn't fit in the last batch, so the next batch starts with it
+    bool batchCurrent;
     
     template<size_t keyIndex, size_t optionsIndex>
     friend argtokey_callback_t cursorArgToKey(CursorWrap* cw, Nan::NAN_METHOD_ARGS_TYPE info, MDBX_val &key, bool &keyIsValid);
@@ -620,6 +1005,20 @@ public:
 
     static NAN_METHOD(getCurrentValue);
     int returnEntry(int lastRC, MDBX_val &key, MDBX_val &data);
+    // whether the entry is past the end key of the current range
+    bool pastEnd(MDBX_val &key, MDBX_val &data);
+    /*
+        Iterates through as many entries as fit in the target buffer (up to the end key, or the maximum count), packing
+        each as a record of the key size, value size, version (if versioned with values), key and value, padded to an
+        8-byte boundary. Returns the number of entries, or 0xffffffff if the next entry doesn't fit in the buffer at
+        all (with the required size written to the start of the buffer).
+
+        Parameters:
+
+        * Target buffer
+        * Maximum number of entries
+    */
+    static NAN_METHOD(iterateBatch);
 #if ENABLE_FAST_API && NODE_VERSION_AT_LEAST(16,6,0)
     static uint32_t positionFast(Local<Object> receiver_obj, uint32_t flags, uint32_t offset, uint32_t keySize, uint64_t endKeyAddress, FastApiCallbackOptions& options);
     static uint32_t iterateFast(Local<Object> receiver_obj, FastApiCallbackOptions& options);
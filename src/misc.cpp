@@ -466,12 +466,70 @@ int cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, uint64_t cms)
     clock_gettime(CLOCK_REALTIME, &ts);
     uint64_t ns = ts.tv_nsec + cms * 10000;
     ts.tv_sec += ns / 1000000000;
-    ts.tv_nsec += ns % 1000000000;
+    ts.tv_nsec = ns % 1000000000;
     return pthread_cond_timedwait(cond, mutex, &ts);
 }
 
 #endif
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <limits.h>
+
+int futex_wait(uint32_t* address, uint32_t expected) {
+    return syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+void futex_wake(uint32_t* address) {
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+#elif defined(_WIN32) && _WIN32_WINNT >= 0x0602
+int futex_wait(uint32_t* address, uint32_t expected) {
+    return WaitOnAddress(address, &expected, sizeof(uint32_t), INFINITE) ? 0 : 1;
+}
+
+void futex_wake(uint32_t* address) {
+    WakeByAddressAll(address);
+}
+#else
+// no address based waiting available, so we wait on a shared condition with a short timeout, to cover wake ups
+// that come in between checking the word and waiting
+static pthread_mutex_t* initFutexLock() {
+    pthread_mutex_t* mutex = new pthread_mutex_t;
+    pthread_mutex_init(mutex, nullptr);
+    return mutex;
+}
+static pthread_cond_t* initFutexCond() {
+    pthread_cond_t* cond = new pthread_cond_t;
+    pthread_cond_init(cond, nullptr);
+    return cond;
+}
+static pthread_mutex_t* futexLock = initFutexLock();
+static pthread_cond_t* futexCond = initFutexCond();
+#ifdef _WIN32
+const uint64_t FUTEX_FALLBACK_DELAY = 1; // milliseconds
+#else
+const uint64_t FUTEX_FALLBACK_DELAY = 100; // in units of 10 microseconds
+#endif
+
+int futex_wait(uint32_t* address, uint32_t expected) {
+    int rc = 0;
+    pthread_mutex_lock(futexLock);
+    if (*((volatile uint32_t*) address) == expected)
+        rc = cond_timedwait(futexCond, futexLock, FUTEX_FALLBACK_DELAY);
+    pthread_mutex_unlock(futexLock);
+    return rc;
+}
+
+void futex_wake(uint32_t* address) {
+    pthread_mutex_lock(futexLock);
+    pthread_cond_broadcast(futexCond);
+    pthread_mutex_unlock(futexLock);
+}
+#endif
+
 // This file contains code from the node-lmdb project
 // Copyright (c) 2013-2017 Timur Kristóf
 // Copyright (c) 2021 Kristopher Tate
@@ -0,0 +1,386 @@
+#include "lmdbx-js.h"
+
+using namespace v8;
+using namespace node;
+
+ReadPool::ReadPool(MDBX_env* env) : env(env) {
+    stopping = false;
+    outstandingJobs = 0;
+    pthread_mutex_init(&queueLock, nullptr);
+    pthread_cond_init(&queueCond, nullptr);
+}
+
+ReadPool::~ReadPool() {
+    delete asyncResource;
+    delete events;
+    pthread_mutex_destroy(&queueLock);
+    pthread_cond_destroy(&queueCond);
+}
+
+void ReadPool::Start(unsigned int threadCount) {
+    asyncResource = new Nan::AsyncResource("lmdbx:read");
+    events = new uv_async_t;
+    uv_async_init(Nan::GetCurrentEventLoop(), events, HandleEvents);
+    events->data = this;
+    uv_unref((uv_handle_t*) events); // only keep the event loop alive while reads are outstanding
+    threads.resize(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++)
+        uv_thread_create(&threads[i], Run, this);
+}
+
+void ReadPool::Enqueue(ReadJob* job) {
+    if (outstandingJobs++ == 0)
+        uv_ref((uv_handle_t*) events);
+    job->ew->Ref(); // keep the environment open until the result is delivered
+    pthread_mutex_lock(&queueLock);
+    jobs.push_back(job);
+    pthread_cond_signal(&queueCond);
+    pthread_mutex_unlock(&queueLock);
+}
+
+void ReadPool::Run(void* data) {
+    ReadPool* pool = (ReadPool*) data;
+    MDBX_txn* txn = nullptr;
+    pthread_mutex_lock(&pool->queueLock);
+    while (true) {
+        if (pool->jobs.empty()) {
+            if (pool->stopping)
+                break;
+            pthread_cond_wait(&pool->queueCond, &pool->queueLock);
+            continue;
+        }
+        ReadJob* job = pool->jobs.front();
+        pool->jobs.pop_front();
+        pthread_mutex_unlock(&pool->queueLock);
+        // renew for each job, so every read sees the latest committed snapshot
+        int rc = txn ? mdbx_txn_renew(txn) : mdbx_txn_begin(pool->env, nullptr, MDBX_TXN_RDONLY, &txn);
+        if (rc == 0) {
+            job->Run(txn);
+            mdbx_txn_reset(txn);
+        } else
+            job->error = mdbx_strerror(rc);
+        pthread_mutex_lock(&pool->queueLock);
+        pool->completed.push_back(job);
+        uv_async_send(pool->events);
+    }
+    pthread_mutex_unlock(&pool->queueLock);
+    if (txn)
+        mdbx_txn_abort(txn);
+}
+
+void ReadPool::Stop() {
+    pthread_mutex_lock(&queueLock);
+    stopping = true;
+    pthread_cond_broadcast(&queueCond);
+    pthread_mutex_unlock(&queueLock);
+    for (auto thread = threads.begin(); thread != threads.end(); ++thread)
+        uv_thread_join(&*thread);
+    // the threads have finished their transactions, deliver any remaining results and clean up once the handle closes
+    uv_close((uv_handle_t*) events, [](uv_handle_t* handle) {
+        ReadPool* pool = (ReadPool*) handle->data;
+        pool->Deliver();
+        delete pool;
+    });
+}
+
+void ReadPool::HandleEvents(uv_async_t* handle) {
+    ((ReadPool*) handle->data)->Deliver();
+}
+
+void ReadPool::Deliver() {
+    std::deque<ReadJob*> finished;
+    pthread_mutex_lock(&queueLock);
+    finished.swap(completed);
+    pthread_mutex_unlock(&queueLock);
+    Nan::HandleScope scope;
+    for (ReadJob* job : finished) {
+        Local<v8::Value> argv[2];
+        if (job->error) {
+            argv[0] = Nan::Error(job->error);
+            argv[1] = Nan::Undefined();
+            free(job->result);
+        } else {
+            argv[0] = Nan::Null();
+            // the buffer takes ownership of the result block
+            argv[1] = job->result ? Nan::NewBuffer(job->result, job->resultSize).ToLocalChecked().As<Value>() :
+                Nan::NewBuffer(0).ToLocalChecked().As<Value>();
+        }
+        job->ew->Unref();
+        job->callback->Call(2, argv, asyncResource);
+        delete job->callback;
+        delete[] job->keys;
+        delete job;
+        if (--outstandingJobs == 0 && !stopping)
+            uv_unref((uv_handle_t*) events);
+    }
+}
+
+void ReadJob::Run(MDBX_txn* txn) {
+    std::vector<MDBX_val> keyVals;
+    std::vector<uint32_t> order;
+    getManyKeyOrder(txn, dbi, keys, count, flags & GET_MANY_SORTED, keyVals, order);
+    MDBX_cursor* cursor;
+    int rc = mdbx_cursor_open(txn, dbi, &cursor);
+    if (rc) {
+        error = mdbx_strerror(rc);
+        return;
+    }
+    bool existsOnly = flags & GET_MANY_EXISTS_ONLY;
+    size_t end = existsOnly ? count : (size_t) count * 8;
+    size_t capacity = end > 0x1000 ? end : 0x1000;
+    result = (char*) malloc(capacity);
+    MDBX_val data;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = order[i];
+        rc = mdbx_cursor_get(cursor, &keyVals[index], &data, MDBX_SET_KEY);
+        if (rc && rc != MDBX_NOTFOUND) {
+            error = mdbx_strerror(rc);
+            break;
+        }
+        if (existsOnly) {
+            result[index] = rc ? 0 : 1;
+            continue;
+        }
+        uint32_t* entry = (uint32_t*) (result + index * 8);
+        if (rc == MDBX_NOTFOUND) {
+            entry[0] = 0xffffffff;
+            continue;
+        }
+        if (hasVersions) {
+            data.iov_base = (char*) data.iov_base + 8;
+            data.iov_len -= 8;
+        }
+        size_t length = data.iov_len;
+        bool compressed = compression && length > 0 && ((unsigned char*) data.iov_base)[0] >= 250;
+        if (compressed) {
+            int64_t uncompressedLength = compression->decompressTo(data, nullptr, 0);
+            if (uncompressedLength < 0) {
+                error = "Failed to decompress data";
+                break;
+            }
+            length = uncompressedLength;
+        }
+        if (end + length > capacity) {
+            while (end + length > capacity)
+                capacity <<= 1;
+            result = (char*) realloc(result, capacity);
+            entry = (uint32_t*) (result + index * 8);
+        }
+        entry[0] = end;
+        entry[1] = length;
+        if (compressed) {
+            if (compression->decompressTo(data, result + end, length) < 0) {
+                error = "Failed to decompress data";
+                break;
+            }
+        } else
+            memcpy(result + end, data.iov_base, length);
+        end += length;
+    }
+    mdbx_cursor_close(cursor);
+    resultSize = end;
+}
+
+struct ScanPartition {
+    ScanWorker* worker;
+    int index;
+};
+
+ScanWorker::ScanWorker(DbiWrap* dw, Nan::Callback* callback, bool includeValues)
+    : ew(dw->ew), dbi(dw->dbi), includeValues(includeValues), callback(callback) {
+    hasVersions = includeValues && dw->hasVersions;
+    compression = dw->compression;
+    boundsBlock = nullptr;
+    events = nullptr;
+    asyncResource = nullptr;
+    pendingBlocks = 0;
+    finishedPartitions = 0;
+    stopping = false;
+    pthread_mutex_init(&queueLock, nullptr);
+    pthread_cond_init(&queueCond, nullptr);
+}
+
+ScanWorker::~ScanWorker() {
+    for (MDBX_txn* txn : txns) {
+        if (txn)
+            mdbx_txn_abort(txn);
+    }
+    delete[] boundsBlock;
+    delete callback;
+    delete asyncResource;
+    delete events;
+    pthread_mutex_destroy(&queueLock);
+    pthread_cond_destroy(&queueCond);
+    if (!threads.empty())
+        ew->Unref();
+}
+
+const char* ScanWorker::Start(char* bounds, uint32_t partitions) {
+    boundsBlock = bounds;
+    std::vector<uint32_t> order;
+    getManyKeyOrder(nullptr, dbi, boundsBlock, partitions + 1, true, this->bounds, order);
+    // start a read transaction for each partition, and make sure they are all on the same snapshot (restarting
+    // them if a commit happened while we were starting them)
+    txns.resize(partitions, nullptr);
+    int attempts = 0;
+    while (true) {
+        uint64_t snapshot = 0;
+        bool consistent = true;
+        for (uint32_t i = 0; i < partitions; i++) {
+            int rc = txns[i] ? mdbx_txn_renew(txns[i]) : mdbx_txn_begin(ew->env, nullptr, MDBX_TXN_RDONLY, &txns[i]);
+            if (rc)
+                return mdbx_strerror(rc);
+            uint64_t txnId = mdbx_txn_id(txns[i]);
+            if (i == 0)
+                snapshot = txnId;
+            else if (txnId != snapshot)
+                consistent = false;
+        }
+        if (consistent)
+            break;
+        if (++attempts > 100)
+            return "Unable to start the scan on a consistent snapshot";
+        for (MDBX_txn* txn : txns)
+            mdbx_txn_reset(txn);
+    }
+    ew->Ref(); // keep the environment open until the scan is finished
+    asyncResource = new Nan::AsyncResource("lmdbx:scan");
+    events = new uv_async_t;
+    uv_async_init(Nan::GetCurrentEventLoop(), events, HandleEvents);
+    events->data = this;
+    threads.resize(partitions);
+    for (uint32_t i = 0; i < partitions; i++)
+        uv_thread_create(&threads[i], Run, new ScanPartition { this, (int) i });
+    ew->scans.push_back(this);
+    return nullptr;
+}
+
+void ScanWorker::Stop() {
+    pthread_mutex_lock(&queueLock);
+    stopping = true;
+    pthread_cond_broadcast(&queueCond);
+    pthread_mutex_unlock(&queueLock);
+    for (auto thread = threads.begin(); thread != threads.end(); ++thread)
+        uv_thread_join(&*thread);
+    // like ReadPool::Stop, deliver the remaining blocks and clean up once the handle closes
+    uv_close((uv_handle_t*) events, [](uv_handle_t* handle) {
+        ScanWorker* worker = (ScanWorker*) handle->data;
+        worker->Deliver();
+        delete worker;
+    });
+}
+
+void ScanWorker::Run(void* data) {
+    ScanPartition* partition = (ScanPartition*) data;
+    ScanWorker* worker = partition->worker;
+    int index = partition->index;
+    delete partition;
+    MDBX_txn* txn = worker->txns[index];
+    MDBX_val* lower = worker->bounds[index].iov_len ? &worker->bounds[index] : nullptr;
+    MDBX_val* upper = worker->bounds[index + 1].iov_len ? &worker->bounds[index + 1] : nullptr;
+    const char* error = nullptr;
+    size_t capacity = SCAN_BLOCK_SIZE;
+    char* block = (char*) malloc(capacity);
+    size_t position = 0;
+    uint32_t count = 0;
+    MDBX_cursor* cursor;
+    int rc = mdbx_cursor_open(txn, worker->dbi, &cursor);
+    if (rc == 0) {
+        MDBX_val key, value;
+        if (lower) {
+            key = *lower;
+            rc = mdbx_cursor_get(cursor, &key, &value, MDBX_SET_RANGE);
+        } else
+            rc = mdbx_cursor_get(cursor, &key, &value, MDBX_FIRST);
+        while (rc == 0) {
+            if (worker->stopping.load(std::memory_order_relaxed)) {
+                error = "The environment was closed during the scan";
+                break;
+            }
+            if (upper && mdbx_cmp(txn, worker->dbi, &key, upper) >= 0)
+                break;
+            bool fits;
+            size_t end = packEntry(block, capacity, position, key, value, worker->includeValues, worker->hasVersions,
+                worker->compression, fits);
+            if (!end) {
+                error = "Failed to decompress data";
+                break;
+            }
+            if (!fits) {
+                if (count == 0) { // a single entry that is larger than a block
+                    capacity = end;
+                    block = (char*) realloc(block, capacity);
+                } else {
+                    worker->Send(ScanBlock { index, block, position, count, false, nullptr });
+                    capacity = SCAN_BLOCK_SIZE;
+                    block = (char*) malloc(capacity);
+                    position = 0;
+                    count = 0;
+                }
+                continue; // and pack this entry again
+            }
+            position = end;
+            count++;
+            rc = mdbx_cursor_get(cursor, &key, &value, MDBX_NEXT);
+        }
+        mdbx_cursor_close(cursor);
+    }
+    if (rc && rc != MDBX_NOTFOUND)
+        error = mdbx_strerror(rc);
+    // the transaction is no longer needed, end it now so it doesn't hold back the reclamation of pages
+    mdbx_txn_abort(txn);
+    worker->txns[index] = nullptr;
+    worker->Send(ScanBlock { index, block, position, count, true, error });
+}
+
+void ScanWorker::Send(ScanBlock block) {
+    pthread_mutex_lock(&queueLock);
+    // wait for the JS thread to catch up, if it has fallen behind (unless it is stopping us and won't read any more)
+    while (!block.done && !stopping && pendingBlocks >= threads.size() * 2)
+        pthread_cond_wait(&queueCond, &queueLock);
+    blocks.push_back(block);
+    pendingBlocks++;
+    pthread_mutex_unlock(&queueLock);
+    uv_async_send(events);
+}
+
+void ScanWorker::HandleEvents(uv_async_t* handle) {
+    ScanWorker* worker = (ScanWorker*) handle->data;
+    worker->Deliver();
+    // the callbacks can close the env (once the scan resolves), in which case Stop has joined the threads and is
+    // closing the handle
+    if (worker->stopping)
+        return;
+    if (worker->finishedPartitions == worker->threads.size()) {
+        for (auto thread = worker->threads.begin(); thread != worker->threads.end(); ++thread)
+            uv_thread_join(&*thread);
+        std::vector<ScanWorker*>& scans = worker->ew->scans;
+        scans.erase(std::remove(scans.begin(), scans.end(), worker), scans.end());
+        uv_close((uv_handle_t*) handle, [](uv_handle_t* handle) {
+            delete (ScanWorker*) handle->data;
+        });
+    }
+}
+
+void ScanWorker::Deliver() {
+    std::deque<ScanBlock> delivering;
+    pthread_mutex_lock(&queueLock);
+    delivering.swap(blocks);
+    pendingBlocks -= delivering.size();
+    pthread_cond_broadcast(&queueCond);
+    pthread_mutex_unlock(&queueLock);
+    Nan::HandleScope scope;
+    for (ScanBlock& block : delivering) {
+        Local<v8::Value> argv[] = {
+            block.error ? Nan::Error(block.error) : Nan::Null().As<Value>(),
+            Nan::New<Number>(block.partition),
+            // the buffer takes ownership of the block
+            Nan::NewBuffer(block.data, block.size).ToLocalChecked(),
+            Nan::New<Number>(block.count),
+            Nan::New<v8::Boolean>(block.done)
+        };
+        if (block.done)
+            finishedPartitions++;
+        callback->Call(5, argv, asyncResource);
+    }
+}
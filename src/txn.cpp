@@ -163,7 +163,8 @@ NAN_METHOD(TxnWrap::reset) {
     if (!tw->txn) {
         return Nan::ThrowError("The transaction is already closed.");
     }
-    tw->ew->readTxnRenewed = false;
+    if (tw->ew->currentReadTxn == tw->txn)
+        tw->ew->readTxnRenewed = false;
     mdbx_txn_reset(tw->txn);
 }
 
@@ -176,10 +177,51 @@ NAN_METHOD(TxnWrap::renew) {
         return Nan::ThrowError("The transaction is already closed.");
     }
 
-    int rc = mdbx_txn_renew(tw->txn);
+    int rc = renewReadTxn(tw->txn);
     if (rc != 0) {
         return throwLmdbxError(rc);
     }
+    if (tw->ew->currentReadTxn == tw->txn)
+        tw->ew->readTxnRenewed = true;
+}
+
+NAN_METHOD(TxnWrap::use) {
+    TxnWrap *tw = Nan::ObjectWrap::Unwrap<TxnWrap>(info.This());
+
+    if (!tw->txn) {
+        return Nan::ThrowError("The transaction is already closed.");
+    }
+    tw->ew->currentReadTxn = tw->txn;
+    tw->ew->readTxnRenewed = info[0]->IsTrue();
+}
+
+NAN_METHOD(TxnWrap::info) {
+    TxnWrap *tw = Nan::ObjectWrap::Unwrap<TxnWrap>(info.This());
+
+    if (!tw->txn) {
+        return Nan::ThrowError("The transaction is already closed.");
+    }
+    MDBX_txn_info txnInfo;
+    // scan the reader table, so the retained size only counts the pages that no newer reader also holds
+    int rc = mdbx_txn_info(tw->txn, &txnInfo, true);
+    if (rc != 0) {
+        return throwLmdbxError(rc);
+    }
+    Local<Context> context = Nan::GetCurrentContext();
+    Local<Object> obj = Nan::New<Object>();
+    (void)obj->Set(context, Nan::New<String>("txnId").ToLocalChecked(), Nan::New<Number>(txnInfo.txn_id));
+    (void)obj->Set(context, Nan::New<String>("readerLag").ToLocalChecked(), Nan::New<Number>(txnInfo.txn_reader_lag));
+    (void)obj->Set(context, Nan::New<String>("retainedSize").ToLocalChecked(), Nan::New<Number>(txnInfo.txn_space_retired));
+    info.GetReturnValue().Set(obj);
+}
+
+int renewReadTxn(MDBX_txn* txn) {
+    MDBX_txn_info txnInfo;
+    // checking the reader lag only reads the meta pages, while renewing acquires a reader slot again (a reset txn
+    // fails this check, and is renewed)
+    if (mdbx_txn_info(txn, &txnInfo, false) == 0 && txnInfo.txn_reader_lag == 0)
+        return 0;
+    return mdbx_txn_renew(txn);
 }
 
 // This file contains code from the node-lmdb project
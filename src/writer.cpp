@@ -5,11 +5,10 @@
 8-11 key-size
 12 ... key followed by at least 2 32-bit zeros
 4 value-size
-8 bytes: value pointer (or value itself)
+8 bytes: value pointer (or the value itself, padded to 8 bytes, with HAS_INLINE_VALUE)
 8 compressor pointer?
 8 bytes (optional): conditional version
 8 bytes (optional): version
-inline value?
 */
 #include "lmdbx-js.h"
 #include <atomic>
@@ -26,12 +25,24 @@ const int POINTER_NEXT = 3;
 const int USER_CALLBACK = 8;
 const int USER_CALLBACK_STRICT_ORDER = 0x100000;
 const int DROP_DB = 12;
+const int DELETE_RANGE = 7;
+// merge operators are encoded in bits 21-23 of a put instruction
+const int MERGE_OPERATOR_SHIFT = 21;
+const int MERGE_ADD = 1;
+const int MERGE_MAX = 2;
+const int MERGE_MIN = 3;
+const int MERGE_APPEND = 4;
+const int MERGE_PATCH = 5;
+const int MERGE_REPLACE = 6;
+const int MERGE_FLOAT = 0x800;
 const int HAS_KEY = 4;
 const int HAS_VALUE = 2;
 const int CONDITIONAL = 8;
 const int CONDITIONAL_VERSION = 0x100;
 const int SET_VERSION = 0x200;
 const int HAS_INLINE_VALUE = 0x400;
+// a later put or delete of the same key in the batch replaces this one, so it is not applied
+const int SUPERSEDED = 0x1000;
 const int COMPRESSIBLE = 0x100000;
 const int DELETE_DATABASE = 0x400;
 const int TXN_HAD_ERROR = 0x40000000;
@@ -45,38 +56,204 @@ const int FAILED_CONDITION = 0x4000000;
 const int FINISHED_OPERATION = 0x1000000;
 
 
+#ifdef _WIN32
+const uint64_t TIMED_WAIT_PER_MS = 1;
+#else
+const uint64_t TIMED_WAIT_PER_MS = 100; // cond_timedwait uses units of 10 microseconds
+#endif
+const int SYNC_COMPLETED = 3;
+
+// set on an instruction word that the write thread is parked on, to wake it for something other than a new instruction
+const uint32_t WAKE_WRITER = 0x80000000;
+
 WriteWorker::~WriteWorker() {
-	// TODO: Make sure this runs on the JS main thread, or we need to move it
-	if (envForTxn->writeWorker == this)
-		envForTxn->writeWorker = nullptr;
+	// any batches that were never reported back to JS still own their callbacks
+	for (WriteBatch& batch : batches)
+		delete batch.callback;
+	for (WriteEvent& event : pendingEvents) {
+		if (event.status == 0 || event.status == SYNC_COMPLETED)
+			delete event.callback;
+	}
+	delete asyncResource;
+	pthread_mutex_destroy(&queueLock);
+	pthread_cond_destroy(&queueCond);
+	pthread_cond_destroy(&flushCond);
 }
 
-WriteWorker::WriteWorker(MDBX_env* env, EnvWrap* envForTxn, uint32_t* instructions, Nan::Callback *callback)
-		: Nan::AsyncProgressWorker(callback, "lmdb:write"),
-		envForTxn(envForTxn),
-		instructions(instructions),
+WriteWorker::WriteWorker(MDBX_env* env, EnvWrap* envForTxn)
+		: envForTxn(envForTxn),
 		env(env) {
-	//fprintf(stdout, "nextCompressibleArg %p\n", nextCompressibleArg);
-		interruptionStatus = 0;
-		txn = nullptr;
+	interruptionStatus = 0;
+	interruptedBatchError = 0;
+	finishedProgress = true;
+	closing = false;
+	writerStopped = false;
+	outstandingBatches = 0;
+	txn = nullptr;
+	instructions = nullptr;
+	callback = nullptr;
+	waitingOn = nullptr;
+	errorMessage = nullptr;
+	events = nullptr;
+	asyncResource = nullptr;
+	pthread_mutex_init(&queueLock, nullptr);
+	pthread_cond_init(&queueCond, nullptr);
+	pthread_cond_init(&flushCond, nullptr);
+}
+
+void WriteWorker::Start() {
+	asyncResource = new Nan::AsyncResource("lmdbx:write");
+	events = new uv_async_t;
+	uv_async_init(Nan::GetCurrentEventLoop(), events, HandleEvents);
+	events->data = this;
+	uv_unref((uv_handle_t*) events); // only keep the event loop alive while batches are outstanding
+	uv_thread_create(&thread, Run, this);
+	uv_thread_create(&flushThread, Flush, this);
+}
+
+void WriteWorker::Stop() {
+	pthread_mutex_lock(&queueLock);
+	closing = true;
+	pthread_cond_signal(&queueCond);
+	pthread_mutex_unlock(&queueLock);
+	pthread_mutex_lock(envForTxn->writingLock);
+	Notify();
+	pthread_cond_signal(envForTxn->writingCond);
+	pthread_mutex_unlock(envForTxn->writingLock);
+	uv_thread_join(&thread);
+	// the flush thread finishes any flushes the write thread queued before it exited
+	pthread_mutex_lock(&queueLock);
+	writerStopped = true;
+	pthread_cond_signal(&flushCond);
+	pthread_mutex_unlock(&queueLock);
+	uv_thread_join(&flushThread);
+	// Stop can be called from a callback that HandleEvents is delivering, so the worker is only freed once the
+	// handle has closed
+	uv_close((uv_handle_t*) events, [](uv_handle_t* handle) {
+		delete (WriteWorker*) handle->data;
+		delete (uv_async_t*) handle;
+	});
+}
+
+void WriteWorker::Run(void* data) {
+	WriteWorker* worker = (WriteWorker*) data;
+	while (true) {
+		pthread_mutex_lock(&worker->queueLock);
+		while (worker->batches.empty() && !worker->closing)
+			pthread_cond_wait(&worker->queueCond, &worker->queueLock);
+		if (worker->batches.empty()) {
+			pthread_mutex_unlock(&worker->queueLock);
+			return;
+		}
+		worker->instructions = worker->batches.front().instructions;
+		worker->callback = worker->batches.front().callback;
+		worker->batches.pop_front();
+		pthread_mutex_unlock(&worker->queueLock);
+		worker->Write();
 	}
+}
+
+void WriteWorker::Flush(void* data) {
+	WriteWorker* worker = (WriteWorker*) data;
+	std::vector<WriteBatch> flushing;
+	while (true) {
+		pthread_mutex_lock(&worker->queueLock);
+		while (worker->flushes.empty() && !worker->writerStopped) {
+			unsigned int syncPeriod = worker->envForTxn->syncPeriod;
+			if (syncPeriod) {
+				if (cond_timedwait(&worker->flushCond, &worker->queueLock, syncPeriod * TIMED_WAIT_PER_MS) == 0)
+					continue;
+				// idle, check if the sync period or sync bytes threshold has been reached, without blocking writers
+				pthread_mutex_unlock(&worker->queueLock);
+				mdbx_env_sync_poll(worker->env);
+				pthread_mutex_lock(&worker->queueLock);
+			} else
+				pthread_cond_wait(&worker->flushCond, &worker->queueLock);
+		}
+		if (worker->flushes.empty()) {
+			pthread_mutex_unlock(&worker->queueLock);
+			return;
+		}
+		flushing.swap(worker->flushes);
+		pthread_mutex_unlock(&worker->queueLock);
+		// a single flush covers every commit (and sync request) that was queued while the previous flush was
+		// running, and everything committed before it starts is durable once it finishes
+		MDBX_envinfo info;
+		uint64_t txnId = mdbx_env_info_ex(worker->env, nullptr, &info, sizeof(info)) ? 0 : info.mi_recent_txnid;
+		int rc = mdbx_env_sync_ex(worker->env, true, false);
+		if (rc == MDBX_RESULT_TRUE) // nothing needed to be flushed
+			rc = 0;
+		for (WriteBatch& batch : flushing) {
+			if (batch.instructions) // the commit is only reported once it is durable
+				std::atomic_fetch_or((std::atomic<uint32_t>*) batch.instructions, (uint32_t) (rc ? TXN_HAD_ERROR : TXN_COMMITTED));
+			worker->SendEvent(batch.syncRequest ? SYNC_COMPLETED : 0, rc ? mdbx_strerror(rc) : batch.error, batch.callback, txnId);
+		}
+		flushing.clear();
+	}
+}
+
+void WriteWorker::RequestFlush(uint32_t* instructions, Nan::Callback* callback, const char* error) {
+	pthread_mutex_lock(&queueLock);
+	flushes.push_back({ instructions, callback, error, false });
+	pthread_cond_signal(&flushCond);
+	pthread_mutex_unlock(&queueLock);
+}
+
+void WriteWorker::Sync(Nan::Callback* callback) {
+	if (outstandingBatches++ == 0)
+		uv_ref((uv_handle_t*) events);
+	pthread_mutex_lock(&queueLock);
+	flushes.push_back({ nullptr, callback, nullptr, true });
+	pthread_cond_signal(&flushCond);
+	pthread_mutex_unlock(&queueLock);
+}
+
+void WriteWorker::Enqueue(uint32_t* instructions, Nan::Callback* callback) {
+	if (outstandingBatches++ == 0)
+		uv_ref((uv_handle_t*) events);
+	pthread_mutex_lock(&queueLock);
+	batches.push_back({ instructions, callback, nullptr, false });
+	pthread_cond_signal(&queueCond);
+	pthread_mutex_unlock(&queueLock);
+}
 
-void WriteWorker::Execute(const ExecutionProgress& executionProgress) {
-	this->executionProgress = (ExecutionProgress*) &executionProgress;
-	Write();
+void WriteWorker::SendEvent(int status, const char* error, Nan::Callback* callback, uint64_t txnId) {
+	pthread_mutex_lock(&queueLock);
+	if (!(status == 2 && !pendingEvents.empty() && pendingEvents.back().status == 2 &&
+			pendingEvents.back().callback == callback)) // coalesce progress requests
+		pendingEvents.push_back({ status, error, callback, txnId });
+	pthread_mutex_unlock(&queueLock);
+	uv_async_send(events);
 }
+
+// wake the write thread if it is parked on an instruction word; this must be called from the JS thread, which is
+// the only other thread that writes to the instruction words
+void WriteWorker::Notify() {
+	uint32_t* target = waitingOn;
+	if (target) {
+		uint32_t expected = WAITING_OPERATION;
+		std::atomic_compare_exchange_strong((std::atomic<uint32_t>*) target, &expected, WAITING_OPERATION | WAKE_WRITER);
+		futex_wake(target);
+	}
+}
+
 MDBX_txn* WriteWorker::AcquireTxn(int* flags) {
 	bool commitSynchronously = *flags & TXN_SYNCHRONOUS_COMMIT;
 	
-	// TODO: if the conditionDepth is 0, we could allow the current worker's txn to be continued, committed and restarted
 	pthread_mutex_lock(envForTxn->writingLock);
 	if (commitSynchronously && interruptionStatus == ALLOW_COMMIT) {
 		//fprintf(stderr, "acquire interupting lock %p %u\n", this, commitSynchronously);
+		// ask the write thread to pause the batch and lend us its txn, the synchronous transaction runs nested in
+		// it and commits it, so the interruption doesn't cost an extra commit
 		interruptionStatus = INTERRUPT_BATCH;
+		Notify();
 		pthread_cond_signal(envForTxn->writingCond);
-		pthread_cond_wait(envForTxn->writingCond, envForTxn->writingLock);
-        *flags |= TXN_FROM_WORKER;
-		return nullptr;
+		do {
+			pthread_cond_wait(envForTxn->writingCond, envForTxn->writingLock);
+		} while (interruptionStatus == INTERRUPT_BATCH);
+		interruptionStatus = USER_HAS_LOCK;
+		*flags |= TXN_FROM_WORKER | TXN_INTERRUPTED_BATCH;
+		return txn;
 	} else {
 		//if (interruptionStatus == RESTART_WORKER_TXN)
 		//	pthread_cond_wait(envForTxn->writingCond, envForTxn->writingLock);
@@ -94,43 +271,60 @@ void WriteWorker::UnlockTxn() {
 	pthread_mutex_unlock(envForTxn->writingLock);
 }
 void WriteWorker::ReportError(const char* error) {
-	SetErrorMessage(error);
+	if (!errorMessage)
+		errorMessage = error;
 }
 int WriteWorker::WaitForCallbacks(MDBX_txn** txn, bool allowCommit, uint32_t* target) {
 	int rc;
 	//fprintf(stderr, "wait for callback %p\n", this);
 	if (!finishedProgress)
-		executionProgress->Send(nullptr, 0);
+		SendEvent(2, nullptr, callback);
 	pthread_cond_signal(envForTxn->writingCond);
 	interruptionStatus = allowCommit ? ALLOW_COMMIT : 0;
 	if (target) {
-		uint64_t delay = 1;
-		do {
-			cond_timedwait(envForTxn->writingCond, envForTxn->writingLock, delay);
-			delay = delay << 1ll;
-			//if (delay > 5000)
-			//	fprintf(stderr, "waited, %llu %p\n", delay, *target);
-		} while(!(
-			(*target & 0xf) ||
-			(allowCommit && (interruptionStatus == INTERRUPT_BATCH || finishedProgress))));
-	} else
+		// park on the instruction word itself, JS will wake us when it writes the next instruction (and even if
+		// it misses our waiting flag, the word will no longer match and the wait returns immediately)
+		uint32_t observed;
+		waitingOn = target;
+		while (!(
+			((observed = *target) & 0xf) ||
+			(allowCommit && (interruptionStatus == INTERRUPT_BATCH || finishedProgress)) || closing)) {
+			if (observed & WAKE_WRITER) {
+				// stale wake up, clear it so we can park again
+				std::atomic_compare_exchange_strong((std::atomic<uint32_t>*) target, &observed, observed & ~WAKE_WRITER);
+				continue;
+			}
+			pthread_mutex_unlock(envForTxn->writingLock);
+			futex_wait(target, observed);
+			pthread_mutex_lock(envForTxn->writingLock);
+		}
+		waitingOn = nullptr;
+	} else if (!closing) // Stop() sets closing before it signals under the writing lock, so this can't miss it
 		pthread_cond_wait(envForTxn->writingCond, envForTxn->writingLock);
 	if (interruptionStatus == INTERRUPT_BATCH) { // interrupted by JS code that wants to run a synchronous transaction
 	//	fprintf(stderr, "Performing batch interruption %u\n", allowCommit);
+		// hand our txn over and wait until the synchronous transaction is completed, it commits our txn (with its
+		// own writes nested in it), unless it was aborted, in which case we just continue with our txn
 		interruptionStatus = RESTART_WORKER_TXN;
-		rc = mdbx_txn_commit(*txn);
-		if (rc == 0) {
-			// wait again until the sync transaction is completed
-			//fprintf(stderr, "Waiting after interruption\n");
-			this->txn = *txn = nullptr;
-			pthread_cond_signal(envForTxn->writingCond);
+		pthread_cond_signal(envForTxn->writingCond);
+		do {
 			pthread_cond_wait(envForTxn->writingCond, envForTxn->writingLock);
+		} while (interruptionStatus == RESTART_WORKER_TXN || interruptionStatus == USER_HAS_LOCK);
+		rc = 0;
+		if (interruptedBatchError) {
+			// the synchronous transaction failed to commit our txn, so the writes of the batch before the interruption
+			// are lost and the batch has failed
+			rc = interruptedBatchError;
+			interruptedBatchError = 0;
+			*txn = nullptr;
+		} else if (!this->txn) {
 			// now restart our transaction
 			rc = mdbx_txn_begin(env, nullptr, MDBX_TXN_READWRITE, txn);
 			this->txn = *txn;
 			//fprintf(stderr, "Restarted txn after interruption\n");
-			interruptionStatus = 0;
-		}
+		} else
+			*txn = this->txn;
+		interruptionStatus = 0;
 		if (rc != 0) {
 			fprintf(stdout, "wfc unlock due to error %u\n", rc);
 			return rc;
@@ -139,12 +333,270 @@ int WriteWorker::WaitForCallbacks(MDBX_txn** txn, bool allowCommit, uint32_t* ta
 		interruptionStatus = 0;
 	return 0;
 }
+// delete every entry from the start key (or the first entry if there is no start key) up to, but not including, the
+// end key (or to the end if there is no end key). With a chunk size, the transaction is committed and a new one
+// started after every chunkSize deleted entries, so deleting a huge range doesn't accumulate an unbounded dirty
+// page list or hold the write lock for the whole range
+int deleteRange(MDBX_txn** txn, MDBX_env* env, WriteWorker* worker, MDBX_dbi dbi, MDBX_val* start, MDBX_val* end, size_t chunkSize) {
+	MDBX_cursor* cursor;
+	MDBX_val key, data;
+	size_t deleted = 0;
+	int rc = mdbx_cursor_open(*txn, dbi, &cursor);
+	if (rc)
+		return rc;
+	do {
+		if (start) {
+			key = *start;
+			rc = mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
+		} else
+			rc = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST);
+		while (rc == 0) {
+			if (end && mdbx_cmp(*txn, dbi, &key, end) >= 0)
+				break;
+			rc = mdbx_cursor_del(cursor, MDBX_ALLDUPS);
+			if (rc == 0 && chunkSize && ++deleted >= chunkSize)
+				break;
+			// the cursor is left on the entry after the deleted one, which next will return
+			if (rc == 0)
+				rc = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT);
+		}
+		mdbx_cursor_close(cursor);
+		if (rc || deleted < chunkSize || !chunkSize)
+			break;
+		// commit this chunk and continue the range in a new transaction (everything before the range position has
+		// been deleted, so we can simply position at the start again)
+		deleted = 0;
+		rc = mdbx_txn_commit(*txn);
+		if (rc == 0)
+			rc = mdbx_txn_begin(env, nullptr, MDBX_TXN_READWRITE, txn);
+		if (rc)
+			*txn = nullptr; // the batch has no txn to continue in, the caller must stop
+		worker->txn = *txn;
+		if (rc == 0)
+			rc = mdbx_cursor_open(*txn, dbi, &cursor);
+	} while (rc == 0);
+	return rc == MDBX_NOTFOUND ? 0 : rc;
+}
+
+// the cursors for the dbis that a batch writes to, so puts go through a cursor that stays positioned from one put to
+// the next, and keys that arrive in ascending order can be appended at the end without a search from the root
+const int MAX_WRITE_CURSORS = 8;
+struct WriteCursor {
+	MDBX_dbi dbi;
+	MDBX_cursor* cursor;
+	bool atEnd; // the cursor is on the last entry, so the next put will likely be an append
+	bool dupSort;
+};
+class WriteCursors {
+public:
+	WriteCursor cursors[MAX_WRITE_CURSORS];
+	int count = 0;
+	uint64_t txnId = 0;
+	WriteCursor* get(MDBX_txn* txn, MDBX_dbi dbi) {
+		uint64_t id = mdbx_txn_id(txn);
+		if (id != txnId) {
+			// the batch was committed and continued in a new transaction, move the cursors over to it
+			for (int i = 0; i < count; i++) {
+				cursors[i].atEnd = false;
+				if (mdbx_cursor_bind(txn, cursors[i].cursor, cursors[i].dbi))
+					release(cursors[i--].dbi);
+			}
+			txnId = id;
+		}
+		for (int i = 0; i < count; i++) {
+			if (cursors[i].dbi == dbi)
+				return &cursors[i];
+		}
+		if (count == MAX_WRITE_CURSORS)
+			return nullptr;
+		WriteCursor* writeCursor = &cursors[count];
+		unsigned dbFlags;
+		if (mdbx_dbi_flags(txn, dbi, &dbFlags) || mdbx_cursor_open(txn, dbi, &writeCursor->cursor))
+			return nullptr;
+		writeCursor->dbi = dbi;
+		writeCursor->dupSort = dbFlags & MDBX_DUPSORT;
+		MDBX_val lastKey, lastData;
+		int rc = mdbx_cursor_get(writeCursor->cursor, &lastKey, &lastData, MDBX_LAST);
+		writeCursor->atEnd = !writeCursor->dupSort && (rc == 0 || rc == MDBX_NOTFOUND);
+		count++;
+		return writeCursor;
+	}
+	void release(MDBX_dbi dbi) {
+		for (int i = 0; i < count; i++) {
+			if (cursors[i].dbi == dbi) {
+				mdbx_cursor_close(cursors[i].cursor);
+				cursors[i] = cursors[--count];
+				return;
+			}
+		}
+	}
+	~WriteCursors() {
+		for (int i = 0; i < count; i++)
+			mdbx_cursor_close(cursors[i].cursor);
+	}
+};
+
+// put through the batch cursor for the dbi, appending if the key comes after the last key (which mdbx verifies, so
+// if something else was written at the end, we fall back to a normal put)
+int cursorPut(WriteCursor* writeCursor, MDBX_txn* txn, MDBX_val* key, MDBX_val* value, MDBX_put_flags_t flags,
+		double* version) {
+	MDBX_val data = *value;
+	if (version) {
+		// leave 8 header bytes for the version and copy in with reserved memory
+		data.iov_len += 8;
+		flags = (MDBX_put_flags_t) (flags | MDBX_RESERVE);
+	}
+	int rc = MDBX_EKEYMISMATCH;
+	if (writeCursor->atEnd && !(flags & (MDBX_APPEND | MDBX_APPENDDUP))) {
+		MDBX_val lastKey, lastData;
+		if (mdbx_cursor_get(writeCursor->cursor, &lastKey, &lastData, MDBX_GET_CURRENT) ||
+				mdbx_cmp(txn, writeCursor->dbi, key, &lastKey) > 0)
+			rc = mdbx_cursor_put(writeCursor->cursor, key, &data, (MDBX_put_flags_t) (flags | MDBX_APPEND));
+	}
+	if (rc == MDBX_EKEYMISMATCH) {
+		if (version)
+			data.iov_len = value->iov_len + 8;
+		rc = mdbx_cursor_put(writeCursor->cursor, key, &data, flags);
+	}
+	if (rc == 0) {
+		if (version) {
+			memcpy(data.iov_base, version, 8);
+			memcpy((char*) data.iov_base + 8, value->iov_base, value->iov_len);
+		}
+		writeCursor->atEnd = !writeCursor->dupSort && mdbx_cursor_on_last(writeCursor->cursor) == MDBX_RESULT_TRUE;
+	}
+	return rc;
+}
+
+static inline double addNumbers(double a, double b) {
+	return a + b;
+}
+// int64s wrap around on overflow (like a bigint written with writeBigInt64LE), signed overflow would be undefined
+static inline int64_t addNumbers(int64_t a, int64_t b) {
+	return (int64_t) ((uint64_t) a + (uint64_t) b);
+}
+
+template <typename T>
+static void mergeNumber(int op, char* current, char* operand, char* target) {
+	T a, b;
+	memcpy(&b, operand, sizeof(T));
+	if (current) {
+		memcpy(&a, current, sizeof(T));
+		b = op == MERGE_ADD ? addNumbers(a, b) : op == MERGE_MAX ? (a > b ? a : b) : (a < b ? a : b);
+	}
+	memcpy(target, &b, sizeof(T));
+}
+
+// apply a merge operator as a read-modify-write of the current value on the write thread, so counters and logs
+// don't need a callback to JS. The merged value is written into reserved space, after the version if there is one.
+// A get-and-set hands the previous value back to JS through the value slot of the instruction.
+int mergeValue(MDBX_txn* txn, MDBX_dbi dbi, MDBX_val* key, MDBX_val* operand, uint32_t flags, double* version,
+		double* resultSlot) {
+	MDBX_val existing, data;
+	size_t headerSize = version ? 8 : 0;
+	int op = (flags >> MERGE_OPERATOR_SHIFT) & 7;
+	int rc = mdbx_get(txn, dbi, key, &existing);
+	if (rc && rc != MDBX_NOTFOUND)
+		return rc;
+	// the current value is only valid until we write, so it has to be copied out first
+	char localCopy[16];
+	char* current = nullptr;
+	size_t currentSize = 0;
+	if (rc == 0 && existing.iov_len >= headerSize) {
+		currentSize = existing.iov_len - headerSize;
+		current = (currentSize <= sizeof(localCopy) && op != MERGE_REPLACE) ? localCopy : (char*) malloc(currentSize + 1);
+		memcpy(current, (char*) existing.iov_base + headerSize, currentSize);
+	}
+	size_t resultSize;
+	uint32_t patchOffset = 0;
+	switch (op) {
+	case MERGE_ADD: case MERGE_MAX: case MERGE_MIN:
+		// numbers are fixed width (8 byte) little-endian doubles or int64s
+		rc = operand->iov_len == 8 && (!current || currentSize == 8) ? 0 : MDBX_BAD_VALSIZE;
+		resultSize = 8;
+		break;
+	case MERGE_APPEND:
+		resultSize = currentSize + operand->iov_len;
+		break;
+	case MERGE_PATCH:
+		// the operand starts with the 32-bit offset to write the rest of the bytes at
+		if (operand->iov_len < 4) {
+			rc = MDBX_BAD_VALSIZE;
+			break;
+		}
+		memcpy(&patchOffset, operand->iov_base, 4);
+		resultSize = patchOffset + operand->iov_len - 4;
+		if (resultSize < currentSize)
+			resultSize = currentSize;
+		break;
+	case MERGE_REPLACE:
+		resultSize = operand->iov_len;
+		break;
+	default:
+		rc = MDBX_EINVAL;
+	}
+	if (rc == 0) {
+		data.iov_len = resultSize + headerSize;
+		rc = mdbx_put(txn, dbi, key, &data, MDBX_RESERVE);
+	}
+	if (rc == 0) {
+		char* target = (char*) data.iov_base;
+		if (version) {
+			memcpy(target, version, 8);
+			target += 8;
+		}
+		switch (op) {
+		case MERGE_ADD: case MERGE_MAX: case MERGE_MIN:
+			if (flags & MERGE_FLOAT)
+				mergeNumber<double>(op, current, (char*) operand->iov_base, target);
+			else
+				mergeNumber<int64_t>(op, current, (char*) operand->iov_base, target);
+			break;
+		case MERGE_APPEND:
+			if (current)
+				memcpy(target, current, currentSize);
+			memcpy(target + currentSize, operand->iov_base, operand->iov_len);
+			break;
+		case MERGE_PATCH:
+			if (current)
+				memcpy(target, current, currentSize);
+			if (patchOffset > currentSize)
+				memset(target + currentSize, 0, patchOffset - currentSize);
+			memcpy(target + patchOffset, (char*) operand->iov_base + 4, operand->iov_len - 4);
+			break;
+		case MERGE_REPLACE:
+			memcpy(target, operand->iov_base, operand->iov_len);
+			// JS takes ownership of the previous value (a null pointer if there wasn't one)
+			*resultSlot = (double) (size_t) current;
+			*((uint32_t*) resultSlot - 1) = currentSize;
+			current = nullptr;
+			break;
+		}
+	}
+	if (current != localCopy)
+		free(current);
+	return rc;
+}
+
+NAN_METHOD(EnvWrap::takeWriteResult) {
+	double* slot = (double*) (size_t) Local<Number>::Cast(info[0])->Value();
+	char* result = (char*) (size_t) *slot;
+	if (!result)
+		return info.GetReturnValue().Set(Nan::Null());
+	*slot = 0;
+	// the buffer takes ownership of the memory (and frees it when collected)
+	info.GetReturnValue().Set(Nan::NewBuffer(result, *((uint32_t*) slot - 1)).ToLocalChecked());
+}
+
 int DoWrites(MDBX_txn* txn, EnvWrap* envForTxn, uint32_t* instruction, WriteWorker* worker) {
 	MDBX_val key, value;
 	int rc = 0;
 	int conditionDepth = 0;
 	int validatedDepth = 0;
 	double conditionalVersion, setVersion = 0;
+	double* valueSlot = nullptr;
+	WriteCursors cursors;
+	WriteCursor* writeCursor;
 	bool overlappedWord = !!worker;
 	uint32_t* start;
 		do {
@@ -152,7 +604,7 @@ next_inst:	start = instruction++;
 		uint32_t flags = *start;
 		MDBX_dbi dbi = 0;
 		bool validated = conditionDepth == validatedDepth;
-		if (flags & 0xf0c0) {
+		if (flags & 0xe0c0) {
 			fprintf(stderr, "Unknown flag bits %u %p\n", flags, start);
 			fprintf(stderr, "flags after message %u\n", *start);
 			worker->ReportError("Unknown flags\n");
@@ -185,7 +637,13 @@ next_inst:	start = instruction++;
 						fprintf(stderr, "compression not completed %p %i\n", value.iov_base, (int) status);
 					value.iov_len = *(instruction - 1);
 					instruction += 4; // skip compression pointers
+				} else if (flags & HAS_INLINE_VALUE) {
+					// the value was copied into the instructions, right after its size
+					value.iov_base = instruction;
+					value.iov_len = *(instruction - 1);
+					instruction += ((value.iov_len + 7) >> 3) << 1;
 				} else {
+					valueSlot = (double*) instruction;
 					value.iov_base = (void*)(size_t) * ((double*)instruction);
 					value.iov_len = *(instruction - 1);
 					instruction += 2;
@@ -211,7 +669,11 @@ next_inst:	start = instruction++;
 		} else
 			instruction++;
 		//fprintf(stderr, "instr flags %p %p %u\n", start, flags, conditionDepth);
-		if (validated || !(flags & CONDITIONAL)) {
+		if (flags & SUPERSEDED) {
+			if ((flags & COMPRESSIBLE) && (flags & HAS_VALUE))
+				free(value.iov_base);
+			flags = FINISHED_OPERATION;
+		} else if (validated || !(flags & CONDITIONAL)) {
 			switch (flags & 0xf) {
 			case NO_INSTRUCTION_YET:
 				instruction -= 2; // reset back to the previous flag as the current instruction
@@ -219,11 +681,15 @@ next_inst:	start = instruction++;
 				//fprintf(stderr, "no instruction yet %p %u\n", start, conditionDepth);
 				// in windows InterlockedCompareExchange might be faster
 				if (!worker->finishedProgress || conditionDepth) {
+					if (worker->closing)
+						return MDBX_BAD_TXN; // the env is closing and no more instructions will come, abandon this batch
 					//fprintf(stderr, "write thread waiting %p\n", lastStart);
 					if (std::atomic_compare_exchange_strong((std::atomic<uint32_t>*) start,
 							(uint32_t*) &flags,
 							(uint32_t)WAITING_OPERATION))
-						worker->WaitForCallbacks(&txn, conditionDepth == 0, start);
+						rc = worker->WaitForCallbacks(&txn, conditionDepth == 0, start);
+					if (rc)
+						return rc;
 					goto next_inst;
 				} else {
 					if (std::atomic_compare_exchange_strong((std::atomic<uint32_t>*) start,
@@ -244,7 +710,13 @@ next_inst:	start = instruction++;
 				}
 				goto next_inst;
 			case PUT:
-				if (flags & SET_VERSION)
+				if (flags & (7 << MERGE_OPERATOR_SHIFT))
+					rc = mergeValue(txn, dbi, &key, &value, flags, (flags & SET_VERSION) ? &setVersion : nullptr, valueSlot);
+				else if (worker && (writeCursor = cursors.get(txn, dbi)))
+					rc = cursorPut(writeCursor, txn, &key, &value,
+						(MDBX_put_flags_t)(flags & (MDBX_NOOVERWRITE | MDBX_NODUPDATA | MDBX_APPEND | MDBX_APPENDDUP)),
+						(flags & SET_VERSION) ? &setVersion : nullptr);
+				else if (flags & SET_VERSION)
 					rc = putWithVersion(txn, dbi, &key, &value, flags & (MDBX_NOOVERWRITE | MDBX_NODUPDATA | MDBX_APPEND | MDBX_APPENDDUP), setVersion);
 				else
 					rc = mdbx_put(txn, dbi, &key, &value, (MDBX_put_flags_t)(flags & (MDBX_NOOVERWRITE | MDBX_NODUPDATA | MDBX_APPEND | MDBX_APPENDDUP)));
@@ -274,12 +746,31 @@ next_inst:	start = instruction++;
 					//fprintf(stderr, "strict order\n");
 					std::atomic_fetch_or((std::atomic<uint32_t>*) start, (uint32_t) FINISHED_OPERATION); // mark it as finished so it is processed
 					while (!worker->finishedProgress) {
-						worker->WaitForCallbacks(&txn, conditionDepth == 0, nullptr);
+						// the callback runs on the JS thread, which won't run it if it is closing the env (and joining us)
+						if (worker->closing)
+							return MDBX_BAD_TXN;
+						rc = worker->WaitForCallbacks(&txn, conditionDepth == 0, nullptr);
+						if (rc)
+							return rc;
 					}
 				}
 				break;
 			case DROP_DB:
-				rc = mdbx_drop(txn, dbi, (flags & DELETE_DATABASE) ? 1 : 0);
+				cursors.release(dbi);
+				// chunking is only possible at the top level of an async batch, since the commits end the
+				// atomicity of any enclosing block; elsewhere the drop just happens in the current transaction
+				rc = ((flags & SET_VERSION) && worker && conditionDepth == 0) ?
+					deleteRange(&txn, envForTxn->env, worker, dbi, nullptr, nullptr, (size_t) setVersion) : 0;
+				if (rc == 0)
+					rc = mdbx_drop(txn, dbi, (flags & DELETE_DATABASE) ? 1 : 0);
+				break;
+			case DELETE_RANGE:
+				cursors.release(dbi);
+				// the start key is the instruction key and the end key is passed like a value, the version slot
+				// holds the chunk size
+				rc = deleteRange(&txn, envForTxn->env, worker, dbi, key.iov_len ? &key : nullptr,
+					value.iov_len ? &value : nullptr,
+					((flags & SET_VERSION) && worker && conditionDepth == 0) ? (size_t) setVersion : 0);
 				break;
 			case POINTER_NEXT:
 				instruction = (uint32_t*)(size_t) * ((double*)instruction);
@@ -290,6 +781,11 @@ next_inst:	start = instruction++;
 				worker->ReportError("Unknown flags\n");
 				return 22;
 			}
+			if (!txn) {
+				// a chunked delete committed and couldn't start the next txn, so the rest of the batch can't be written
+				std::atomic_fetch_or((std::atomic<uint32_t>*) start, (uint32_t) (FINISHED_OPERATION | FAILED_CONDITION));
+				return rc;
+			}
 			if (rc) {
 				if (!(rc == MDBX_KEYEXIST || rc == MDBX_NOTFOUND)) {
 					if (worker) {
@@ -318,75 +814,96 @@ next_inst:	start = instruction++;
 void WriteWorker::Write() {
 	int rc;
 	finishedProgress = true;
-	unsigned int envFlags;
-	mdbx_env_get_flags(env, &envFlags);
+	errorMessage = nullptr;
+	bool overlappingSync = envForTxn->jsFlags & OVERLAPPING_SYNC;
 	pthread_mutex_lock(envForTxn->writingLock);
-	rc = mdbx_txn_begin(env, nullptr, /*(envFlags & MDBX_OVERLAPPINGSYNC) ? MDBX_NOSYNC : */MDBX_TXN_READWRITE, &txn);
-	if (rc != 0) {
-		return SetErrorMessage(mdbx_strerror(rc));
-	}
-
-	rc = DoWrites(txn, envForTxn, instructions, this);
-
-	if (callback) {
-		if (rc)
-			mdbx_txn_abort(txn);
-		else
-			rc = mdbx_txn_commit(txn);
-		txn = nullptr;
-		pthread_mutex_unlock(envForTxn->writingLock);
+	rc = mdbx_txn_begin(env, nullptr, MDBX_TXN_READWRITE, &txn);
+	if (rc == 0) {
+		rc = DoWrites(txn, envForTxn, instructions, this);
 		if (rc) {
-			std::atomic_fetch_or((std::atomic<uint32_t>*) instructions, (uint32_t) TXN_HAD_ERROR);
-			return SetErrorMessage(mdbx_strerror(rc));
-		}/* else if (envFlags & MDBX_OVERLAPPINGSYNC) {
-			// note that once we set the instructions byte to committed, we can *not* touch it again
-			// because JS can then GC and deallocate the buffer it references and it can segfault if we access again
-			if (envForTxn->jsFlags & SEPARATE_FLUSHED)
-				std::atomic_fetch_or((std::atomic<uint32_t>*) instructions, (uint32_t) TXN_COMMITTED);
-			progressStatus = 1;
-			executionProgress->Send(nullptr, 0);
-			rc = mdbx_env_sync(env, true);
-			if (!(envForTxn->jsFlags & SEPARATE_FLUSHED))
-				std::atomic_fetch_or((std::atomic<uint32_t>*) instructions, (uint32_t) TXN_COMMITTED);
-		} */else {
+			if (txn) // null if a chunked delete lost it
+				mdbx_txn_abort(txn);
+		} else
+			rc = mdbx_txn_commit(txn);
+	}
+	txn = nullptr;
+	pthread_mutex_unlock(envForTxn->writingLock);
+	if (rc) {
+		std::atomic_fetch_or((std::atomic<uint32_t>*) instructions, (uint32_t) TXN_HAD_ERROR);
+		return SendEvent(0, mdbx_strerror(rc), callback);
+	}
+	if (overlappingSync) {
+		// the commit didn't wait for the disk, the flush thread makes it durable while we move on to the next batch
+		if (envForTxn->jsFlags & SEPARATE_FLUSHED) {
 			std::atomic_fetch_or((std::atomic<uint32_t>*) instructions, (uint32_t) TXN_COMMITTED);
-		}
-	} else
-		interruptionStatus = rc;
+			SendEvent(1, nullptr, callback);
+			RequestFlush(nullptr, callback, errorMessage);
+		} else
+			RequestFlush(instructions, callback, errorMessage);
+		return;
+	}
+	// note that once we set the instructions byte to committed, we can *not* touch it again
+	// because JS can then GC and deallocate the buffer it references and it can segfault if we access again
+	std::atomic_fetch_or((std::atomic<uint32_t>*) instructions, (uint32_t) TXN_COMMITTED);
+	SendEvent(0, errorMessage, callback);
 }
 
-void WriteWorker::HandleProgressCallback(const char* data, size_t count) {
+void WriteWorker::HandleEvents(uv_async_t* handle) {
+	WriteWorker* worker = (WriteWorker*) handle->data;
 	Nan::HandleScope scope;
-	v8::Local<v8::Value> argv[] = {
-		Nan::New<Number>(progressStatus)
-	};
-	if (progressStatus == 1) {
-		callback->Call(1, argv, async_resource).ToLocalChecked()->IsTrue();
-		return;
+	std::vector<WriteEvent> events;
+	pthread_mutex_lock(&worker->queueLock);
+	events.swap(worker->pendingEvents);
+	pthread_mutex_unlock(&worker->queueLock);
+	for (WriteEvent& event : events) {
+		if (event.status == 2) {
+			// once the env is closing (from an earlier callback), there is no write thread to hand the txn back to
+			if (!worker->closing)
+				worker->HandleProgressCallback(event.callback);
+			continue;
+		}
+		if (event.status == SYNC_COMPLETED) {
+			v8::Local<v8::Value> argv[] = {
+				event.error ? Nan::Error(event.error) : Nan::Null().As<Value>(),
+				Nan::New<Number>((double) event.txnId)
+			};
+			if (--worker->outstandingBatches == 0)
+				uv_unref((uv_handle_t*) handle);
+			event.callback->Call(2, argv, worker->asyncResource);
+			delete event.callback;
+			continue;
+		}
+		v8::Local<v8::Value> argv[] = {
+			event.error ? Nan::Error(event.error) : Nan::New<Number>(event.status).As<Value>()
+		};
+		// the batch is finished
+		if (event.status == 0 && --worker->outstandingBatches == 0)
+			uv_unref((uv_handle_t*) handle);
+		event.callback->Call(1, argv, worker->asyncResource);
+		if (event.status == 0)
+			delete event.callback;
 	}
+}
+
+void WriteWorker::HandleProgressCallback(Nan::Callback* callback) {
 	if (finishedProgress)
 		return;
+	v8::Local<v8::Value> argv[] = {
+		Nan::New<Number>(2)
+	};
 	pthread_mutex_lock(envForTxn->writingLock);
 	while(!txn) // possible to jump in after an interrupted txn here
 		pthread_cond_wait(envForTxn->writingCond, envForTxn->writingLock);
 	envForTxn->writeTxn = new TxnTracked(txn, 0);
 	finishedProgress = true;
-	callback->Call(1, argv, async_resource).ToLocalChecked()->IsTrue();
+	callback->Call(1, argv, asyncResource);
 	delete envForTxn->writeTxn;
 	envForTxn->writeTxn = nullptr;
+	Notify();
 	pthread_cond_signal(envForTxn->writingCond);
 	pthread_mutex_unlock(envForTxn->writingLock);
 }
 
-void WriteWorker::HandleOKCallback() {
-	Nan::HandleScope scope;
-	Local<v8::Value> argv[] = {
-		Nan::New<Number>(0)
-	};
-	finishedProgress = true;
-	callback->Call(1, argv, async_resource);
-}
-
 NAN_METHOD(EnvWrap::startWriting) {
     EnvWrap *ew = Nan::ObjectWrap::Unwrap<EnvWrap>(info.This());
     if (!ew->env) {
@@ -394,10 +911,7 @@ NAN_METHOD(EnvWrap::startWriting) {
     }
     size_t instructionAddress = Local<Number>::Cast(info[0])->Value();
     Nan::Callback* callback = new Nan::Callback(Local<v8::Function>::Cast(info[1]));
-
-    WriteWorker* worker = new WriteWorker(ew->env, ew, (uint32_t*) instructionAddress, callback);
-	ew->writeWorker = worker;
-    Nan::AsyncQueueWorker(worker);
+    ew->getWriteWorker()->Enqueue((uint32_t*) instructionAddress, callback);
 }
 
 
@@ -409,7 +923,8 @@ void EnvWrap::writeFast(Local<Object> receiver_obj, uint64_t instructionAddress,
 	if (instructionAddress)
 		rc = DoWrites(ew->writeTxn->txn, ew, (uint32_t*)instructionAddress, nullptr);
 	else {
-		pthread_cond_signal(ew->writingCond);
+		if (ew->writeWorker)
+			ew->writeWorker->Notify();
 		rc = 0;
 	}
 	if (rc && !(rc == MDBX_KEYEXIST || rc == MDBX_NOTFOUND))
@@ -430,7 +945,7 @@ void EnvWrap::write(
 	if (instructionAddress)
 		rc = DoWrites(ew->writeTxn->txn, ew, (uint32_t*)instructionAddress, nullptr);
 	else if (ew->writeWorker) {
-		pthread_cond_signal(ew->writingCond);
+		ew->writeWorker->Notify();
 	}
 	if (rc && !(rc == MDBX_KEYEXIST || rc == MDBX_NOTFOUND))
 		return Nan::ThrowError(mdbx_strerror(rc));
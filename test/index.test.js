@@ -40,8 +40,11 @@ describe('lmdbx-js', function() {
   let testIteration = 0
   describe('Basic use', basicTests({ }));
   describe('Basic use with overlapping sync', basicTests({ overlappingSync: true }));
+  describe('Basic use with overlapping sync and separate flushed', basicTests({ overlappingSync: true, separateFlushed: true }));
   describe('Basic use with encryption', basicTests({ compression: false, encryptionKey: 'Use this key to encrypt the data' }));
   describe('Check encrypted data', basicTests({ compression: false, encryptionKey: 'Use this key to encrypt the data', checkLast: true }));
+  describe('Basic use with coalesced writes', basicTests({ coalesceWrites: true }));
+  describe('Basic use with decompressed value cache', basicTests({ compression: { threshold: 256, decompressedCacheSize: 100000 } }));
   describe('Basic use with JSON', basicTests({ encoding: 'json' }));
   describe('Basic use with ordered-binary', basicTests({ encoding: 'ordered-binary' }));
   if (typeof WeakRef != 'undefined')
@@ -199,6 +202,110 @@ describe('lmdbx-js', function() {
       let data2 = db.get('key1');
       should.equal(data2, undefined);
     });
+    it('values around the inline size', async function() {
+      let puts = [];
+      let values = ['', 'é'.repeat(127), 'é'.repeat(128), 'x'.repeat(380), 'x'.repeat(390), 'x'.repeat(2000)];
+      for (let i = 0; i < values.length; i++)
+        puts.push(db.put('inline-' + i, values[i]));
+      await Promise.all(puts);
+      for (let i = 0; i < values.length; i++) {
+        db.get('inline-' + i).should.equal(values[i]);
+        await db.remove('inline-' + i);
+      }
+    });
+    it('writes across many instruction buffers', async function() {
+      let value = 'a value that takes up some room in the instructions '.repeat(2);
+      for (let round = 0; round < 5; round++) {
+        let puts = [];
+        for (let i = 0; i < 3000; i++)
+          puts.push(db.put(['segments', i], value + round));
+        await Promise.all(puts);
+        db.get(['segments', round * 500]).should.equal(value + round);
+      }
+      await db.removeRange({ start: ['segments'], end: ['segments', 3000] });
+    });
+    it('writes ascending and out of order keys in one batch', async function() {
+      let puts = [];
+      for (let i = 0; i < 1000; i++)
+        puts.push(db.put(['ascending', i * 2], i));
+      // these go before the last key and can't be appended
+      for (let i = 0; i < 100; i++)
+        puts.push(db.put(['ascending', i * 2 + 1], -i));
+      await Promise.all(puts);
+      let keys = Array.from(db.getKeys({ start: ['ascending'], end: ['ascending', 2000] }));
+      keys.length.should.equal(1100);
+      keys[1].should.deep.equal(['ascending', 1]);
+      db.get(['ascending', 1998]).should.equal(999);
+      db.get(['ascending', 199]).should.equal(-99);
+      await db.removeRange({ start: ['ascending'], end: ['ascending', 2000] });
+    });
+    it('repeated writes of a key in one batch', async function() {
+      let results = await Promise.all([
+        db.put('repeated', 'first'),
+        db.put('repeated', 'second', 3),
+        db.remove('repeated'),
+        db.put('repeated', 'third', 4),
+      ]);
+      results.should.deep.equal([true, true, true, true]);
+      db.getEntry('repeated').value.should.equal('third');
+      db.getEntry('repeated').version.should.equal(4);
+      // a condition on the key sees the write before it
+      db.put('repeated', 'fourth', 5);
+      let condition = db.ifVersion('repeated', 5, () => {
+        db.put('repeated-checked', true);
+      });
+      db.put('repeated', 'fifth', 6);
+      (await condition).should.equal(true);
+      db.get('repeated').should.equal('fifth');
+      db.get('repeated-checked').should.equal(true);
+      await db.remove('repeated');
+      await db.remove('repeated-checked');
+    });
+    it('reads across event turns with and without commits', async function() {
+      await db.put('snapshot-check', 1);
+      let keys = Array.from(db.getKeys({ start: 'snapshot-check', end: 'snapshot-check\x00' }));
+      keys.should.deep.equal(['snapshot-check']);
+      await new Promise(resolve => setImmediate(resolve));
+      // nothing committed, the snapshot (and cursor) is kept
+      db.get('snapshot-check').should.equal(1);
+      keys = Array.from(db.getKeys({ start: 'snapshot-check', end: 'snapshot-check\x00' }));
+      keys.should.deep.equal(['snapshot-check']);
+      await db.put('snapshot-check', 2);
+      await new Promise(resolve => setImmediate(resolve));
+      db.get('snapshot-check').should.equal(2);
+      await db.remove('snapshot-check');
+      await new Promise(resolve => setImmediate(resolve));
+      Array.from(db.getKeys({ start: 'snapshot-check', end: 'snapshot-check\x00' })).length.should.equal(0);
+    });
+    it('pinned snapshot', async function() {
+      await db.put('pinned-1', 'first');
+      await db.put('pinned-2', 'first');
+      let snapshot = db.snapshot();
+      await db.put('pinned-1', 'second');
+      await db.remove('pinned-2');
+      db.get('pinned-1').should.equal('second');
+      snapshot.get('pinned-1').should.equal('first');
+      snapshot.get('pinned-2').should.equal('first');
+      snapshot.doesExist('pinned-2').should.equal(true);
+      snapshot.getMany(['pinned-1', 'pinned-2']).should.deep.equal(['first', 'first']);
+      let keys = snapshot.getKeys({ start: 'pinned-', end: 'pinned-\xff' });
+      await new Promise(resolve => setImmediate(resolve));
+      Array.from(keys).should.deep.equal(['pinned-1', 'pinned-2']);
+      let info = snapshot.info();
+      info.readerLag.should.be.at.least(2);
+      info.age.should.be.at.least(0);
+      let reader = db.readerList().find(reader => reader.txnId == info.txnId);
+      reader.pid.should.equal(process.pid);
+      reader.lag.should.be.at.least(2);
+      snapshot.release();
+      should.throw(() => snapshot.get('pinned-1'));
+      // a released snapshot is reused
+      snapshot = db.snapshot();
+      snapshot.get('pinned-1').should.equal('second');
+      should.equal(snapshot.get('pinned-2'), undefined);
+      snapshot.release();
+      await db.remove('pinned-1');
+    });
     it('string with version', async function() {
       await db.put('key1', 'Hello world!', 53252);
       let entry = db.getEntry('key1');
@@ -267,6 +374,59 @@ describe('lmdbx-js', function() {
       (await db.remove('key1')).should.equal(true);
     });
 
+    it('many compressions in one batch', async function() {
+      let str = 'this is a test of a long string that should be compressed '.repeat(40);
+      let puts = [];
+      for (let i = 0; i < 1000; i++)
+        puts.push(db.put('compressed-' + i, str + i));
+      await Promise.all(puts);
+      for (let i = 0; i < 1000; i++)
+        db.get('compressed-' + i).should.equal(str + i);
+      let removes = [];
+      for (let i = 0; i < 1000; i++)
+        removes.push(db.remove('compressed-' + i));
+      await Promise.all(removes);
+    });
+
+    it('reading compressed entries repeatedly and after updates', async function() {
+      let str = 'this is a test of a long string that should be compressed '.repeat(40);
+      await db.put('hot-compressed', str + 1);
+      for (let i = 0; i < 3; i++)
+        db.get('hot-compressed').should.equal(str + 1);
+      await db.put('hot-compressed', str + 2);
+      db.get('hot-compressed').should.equal(str + 2);
+      await db.remove('hot-compressed');
+      should.equal(db.get('hot-compressed'), undefined);
+    });
+
+    it('getMany with a single cursor', async function() {
+      let str = 'this is a test of a long string that should be compressed '.repeat(40);
+      let puts = [];
+      for (let i = 0; i < 100; i++)
+        puts.push(db.put('many-' + i, i % 2 ? str + i : 'small-' + i));
+      await Promise.all(puts);
+      let keys = [];
+      for (let i = 99; i >= 0; i -= 3)
+        keys.push('many-' + i);
+      keys.push('many-not-there');
+      let values = await db.getMany(keys);
+      values.length.should.equal(keys.length);
+      for (let j = 0; j < keys.length - 1; j++) {
+        let i = 99 - j * 3;
+        values[j].should.equal(i % 2 ? str + i : 'small-' + i);
+      }
+      should.equal(values[keys.length - 1], undefined);
+      db.doesExistMany(['many-1', 'many-not-there', 'many-2']).should.deep.equal([true, false, true]);
+      let asyncValues = await db.getManyAsync(keys);
+      asyncValues.should.deep.equal(values);
+      (await db.getAsync('many-3')).should.equal(str + 3);
+      should.equal(await db.getAsync('many-not-there'), undefined);
+      let removes = [];
+      for (let i = 0; i < 100; i++)
+        removes.push(db.remove('many-' + i));
+      await Promise.all(removes);
+    });
+
     it('forced compression due to starting with 255', async function() {
       await db.put('key1', asBinary(Buffer.from([255])));
       let entry = db.getBinary('key1');
@@ -375,6 +535,80 @@ describe('lmdbx-js', function() {
       }))
       result.should.deep.equal([ { key: [ 'foo', 2 ], value: 2 } ])
     })
+    it('should iterate over large ranges in batches', async function() {
+      let str = 'this is a test of a long string that should be compressed '.repeat(40);
+      let puts = [];
+      for (let i = 0; i < 1000; i++)
+        puts.push(db.put(['batch', i], i % 10 ? { i } : { i, str }, i + 1));
+      await Promise.all(puts);
+      let i = 0;
+      for (let { key, value, version } of db.getRange({ start: ['batch'], end: ['batch', 1000], versions: true })) {
+        key.should.deep.equal(['batch', i]);
+        value.i.should.equal(i);
+        if (i % 10 == 0)
+          value.str.should.equal(str);
+        version.should.equal(i + 1);
+        i++;
+      }
+      i.should.equal(1000);
+      db.getCount({ start: ['batch'], end: ['batch', 1000] }).should.equal(1000);
+      let estimate = db.getCount({ start: ['batch'], end: ['batch', 1000], estimate: true });
+      estimate.should.be.above(500);
+      estimate.should.be.below(2000);
+      db.getCount({ start: ['batch', 1000], end: ['batch'], reverse: true, estimate: true }).should.be.above(500);
+      db.getCount().should.equal(Array.from(db.getKeys()).length);
+      let partitions = db.getRangePartitions({ start: ['batch'], end: ['batch', 1000], partitions: 4 });
+      partitions.length.should.be.above(1);
+      partitions[0].start.should.deep.equal(['batch']);
+      let partitionCount = 0;
+      for (let partition of partitions)
+        partitionCount += db.getCount(partition);
+      partitionCount.should.equal(1000);
+      let reversePartitions = db.getRangePartitions({ start: ['batch', 1000], end: ['batch'], reverse: true, partitions: 4 });
+      reversePartitions.length.should.be.above(1);
+      reversePartitions[0].start.should.deep.equal(['batch', 1000]);
+      let lastKey = 1000;
+      partitionCount = 0;
+      for (let partition of reversePartitions) {
+        for (let key of db.getKeys(partition)) {
+          key[1].should.be.below(lastKey);
+          lastKey = key[1];
+          partitionCount++;
+        }
+      }
+      partitionCount.should.equal(1000);
+      (() => db.getRangeParallel({ start: ['batch', 1000], end: ['batch'], reverse: true }, () => {})).should.throw();
+      let scanned = [];
+      await db.getRangeParallel({ start: ['batch'], end: ['batch', 1000], partitions: 4 }, (entries, partition) => {
+        for (let { key, value } of entries) {
+          key[1].should.equal(value.i);
+          scanned.push(key[1]);
+        }
+      });
+      scanned.sort((a, b) => a - b);
+      scanned.length.should.equal(1000);
+      scanned[999].should.equal(999);
+      let keys = Array.from(db.getKeys({ start: ['batch', 999], end: ['batch'], reverse: true, limit: 500 }));
+      keys.length.should.equal(500);
+      keys[499].should.deep.equal(['batch', 500]);
+      let removes = [];
+      for (let i = 0; i < 1000; i++)
+        removes.push(db.remove(['batch', i]));
+      await Promise.all(removes);
+    });
+    it('should remove a range of entries', async function() {
+      let puts = [];
+      for (let i = 0; i < 500; i++)
+        puts.push(db.put(['remove-range', i], i));
+      await Promise.all(puts);
+      await db.removeRange({ start: ['remove-range', 100], end: ['remove-range', 200] });
+      db.getCount({ start: ['remove-range'], end: ['remove-range', 500] }).should.equal(400);
+      should.equal(db.get(['remove-range', 100]), undefined);
+      db.get(['remove-range', 200]).should.equal(200);
+      // chunked across multiple transactions
+      await db.removeRange({ start: ['remove-range'], end: ['remove-range', 500], chunkSize: 30 });
+      db.getCount({ start: ['remove-range'], end: ['remove-range', 500] }).should.equal(0);
+    });
     it('should iterate over query with offset/limit', async function() {
       let data1 = {foo: 1, bar: true}
       let data2 = {foo: 2, bar: false}
@@ -716,6 +950,33 @@ describe('lmdbx-js', function() {
         should.equal(db.get('async2'), 'test');
       }
     });
+    it('aborted sync transaction interrupting an async transaction', async function() {
+      if (db.cache)
+        return
+      let ranSyncTxn;
+      let promise = db.transactionAsync(() => {
+        db.put('async-before-abort', 'test');
+        if (!ranSyncTxn) {
+          ranSyncTxn = true;
+          setImmediate(() => {
+            db.transactionSync(() => {
+              db.put('inside-aborted-sync', 'test');
+              return ABORT;
+            });
+            db.transactionSync(() => {
+              db.put('inside-committed-sync', 'test');
+            });
+            should.equal(db.get('inside-committed-sync'), 'test');
+          });
+        }
+      });
+      await promise;
+      await db.put('async-after-abort', 'test');
+      should.equal(db.get('async-before-abort'), 'test');
+      should.equal(db.get('inside-aborted-sync'), undefined);
+      should.equal(db.get('inside-committed-sync'), 'test');
+      should.equal(db.get('async-after-abort'), 'test');
+    });
     it('multiple async mixed', async function() {
       let result
       for (let i = 0; i < 100; i++) {
@@ -826,6 +1087,34 @@ describe('lmdbx-js', function() {
       should.equal(db.get('test:b'), 2)
       should.equal(db.get('test:c'), undefined)
     });
+    it('sync', async function() {
+      await db.put('sync-key', 'test');
+      let txnIds = await Promise.all([db.sync(), db.sync(), db.sync()]);
+      for (let txnId of txnIds)
+        txnId.should.be.a('number');
+      (txnIds[2] >= txnIds[0]).should.equal(true);
+      await db.remove('sync-key');
+    });
+    it('backup', async function() {
+      await db.put('backup-key', 'test');
+      let progressBytes = 0;
+      await db.backup(testDirPath + '/backup-' + testIteration + '.mdb', {
+        compact: true,
+        bytesPerSecond: 100000000,
+        progress(bytes) {
+          progressBytes = bytes;
+        }
+      });
+      progressBytes.should.be.above(0);
+      let backup = open(testDirPath + '/backup-' + testIteration + '.mdb', Object.assign({
+        name: 'mydb1',
+        useVersions: true,
+        keyEncoder: orderedBinaryEncoder,
+      }, options));
+      backup.getBinary('backup-key').should.deep.equal(db.getBinary('backup-key'));
+      await backup.close();
+      await db.remove('backup-key');
+    });
     it('read and write with binary encoding', async function() {
       let dbBinary = db.openDB(Object.assign({
         name: 'mydb5',
@@ -841,6 +1130,43 @@ describe('lmdbx-js', function() {
       dbBinary.get('Uint8Array')[1].should.equal(2);
       dbBinary.get('empty').length.should.equal(0);
     });
+    it('merge operators', async function() {
+      let dbMerge = db.openDB({
+        name: 'mydb-merge',
+        create: true,
+        compression: false,
+        encoding: 'binary'
+      });
+      let adds = [];
+      for (let i = 0; i < 10; i++)
+        adds.push(dbMerge.add('counter', 1.5));
+      await Promise.all(adds);
+      dbMerge.getBinary('counter').readDoubleLE(0).should.equal(15);
+      await dbMerge.add('big-counter', 5n);
+      await dbMerge.add('big-counter', -2n);
+      dbMerge.getBinary('big-counter').readBigInt64LE(0).should.equal(3n);
+      await dbMerge.add('wrapping-counter', 0x7fffffffffffffffn);
+      await dbMerge.add('wrapping-counter', 1n);
+      dbMerge.getBinary('wrapping-counter').readBigInt64LE(0).should.equal(-0x8000000000000000n);
+      dbMerge.max('max', 3);
+      dbMerge.max('max', 7);
+      await dbMerge.max('max', 5);
+      dbMerge.getBinary('max').readDoubleLE(0).should.equal(7);
+      await dbMerge.min('max', 2);
+      dbMerge.getBinary('max').readDoubleLE(0).should.equal(2);
+      dbMerge.append('log', 'hello');
+      await dbMerge.append('log', Buffer.from(' world'));
+      dbMerge.get('log').toString().should.equal('hello world');
+      await dbMerge.patch('log', 6, 'there');
+      dbMerge.get('log').toString().should.equal('hello there');
+      await dbMerge.patch('log', 11, '!');
+      dbMerge.get('log').toString().should.equal('hello there!');
+      should.equal(await dbMerge.getAndSet('swap', Buffer.from('first')), undefined);
+      (await dbMerge.getAndSet('swap', Buffer.from('second'))).toString().should.equal('first');
+      dbMerge.get('swap').toString().should.equal('second');
+      let previous = await dbMerge.transaction(() => dbMerge.getAndSet('swap', Buffer.from('third')));
+      previous.toString().should.equal('second');
+    });
     it.skip('read and write with binary methods', async function() {
       let dbBinary = db.openDB(Object.assign({
         name: 'mydb6',
@@ -931,6 +1257,103 @@ describe('lmdbx-js', function() {
       console.log('closed')
     });
   });
+  describe('trained compression dictionaries', function() {
+    this.timeout(10000);
+    let db;
+    const openStore = () => open(testDirPath, {
+      name: 'trained-dictionaries',
+      compression: { threshold: 100 },
+      dictionaryKey: Symbol.for('dictionaries'),
+    });
+    const record = (i) => ({ id: i, name: 'customer-' + i, status: i % 3 ? 'active' : 'inactive',
+      address: { street: i + ' Main Street', city: 'Springfield' }, tags: ['alpha', 'beta', 'gamma'] });
+    before(function() {
+      db = openStore();
+    });
+    it('train, recompress, and reopen', async function() {
+      let lastPromise;
+      for (let i = 0; i < 500; i++)
+        lastPromise = db.put(i, record(i));
+      await lastPromise;
+      (await db.trainDictionary({ dictionarySize: 4096 })).should.equal(1);
+      await db.put(500, record(500));
+      db.get(500).should.deep.equal(record(500));
+      // the dictionaries aren't stored in the database itself, so they aren't iterated or counted
+      let count = 0;
+      for (let { key, value } of db.getRange()) {
+        value.should.deep.equal(record(key));
+        count++;
+      }
+      count.should.equal(501);
+      Array.from(db.getKeys()).length.should.equal(501);
+      db.getCount().should.equal(501);
+      (await db.recompress()).should.equal(500);
+      for (let i = 0; i <= 500; i++)
+        db.get(i).should.deep.equal(record(i));
+      db.close();
+      db = openStore();
+      db.get(500).should.deep.equal(record(500));
+      (await db.recompress()).should.equal(0);
+    });
+    it('lz4hc codec, and recompressing with another codec', async function() {
+      let archive = db.openDB('archive', { compression: { threshold: 100, codec: 'lz4hc' } });
+      let lastPromise;
+      for (let i = 0; i < 100; i++)
+        lastPromise = archive.put(i, record(i));
+      await lastPromise;
+      for (let i = 0; i < 100; i++)
+        archive.get(i).should.deep.equal(record(i));
+      let fast = db.openDB('archive', { compression: { threshold: 100 } });
+      fast.get(5).should.deep.equal(record(5));
+      (await fast.recompress()).should.equal(100);
+      (await fast.recompress()).should.equal(0);
+      archive.get(5).should.deep.equal(record(5));
+      should.throw(() => db.openDB('unknown-codec', { compression: { codec: 'brotli' } }));
+    });
+    after(function() {
+      db.close();
+    });
+  });
+  describe('parallel scan', function() {
+    this.timeout(10000);
+    it('can close the database during a scan', async function() {
+      let db = open(testDirPath + '/test-scan.mdb', { sharedStructuresKey: Symbol.for('structures') });
+      let str = 'a long string to make the scan take a few blocks '.repeat(20);
+      let puts = [];
+      for (let i = 0; i < 5000; i++)
+        puts.push(db.put(i, { i, str }));
+      await Promise.all(puts);
+      let scanning = db.getRangeParallel({ partitions: 4 }, () => {});
+      db.close();
+      // the scan threads are stopped and joined by the close, any partitions that didn't finish end with an error
+      let outcome = await scanning.then(() => 'finished', (error) => 'stopped');
+      ['finished', 'stopped'].should.include(outcome);
+    });
+    it('can close the database as soon as a scan resolves', async function() {
+      let db = open(testDirPath + '/test-scan-resolve.mdb', {});
+      let puts = [];
+      for (let i = 0; i < 1000; i++)
+        puts.push(db.put(i, { i }));
+      await Promise.all(puts);
+      let count = 0;
+      await db.getRangeParallel({ partitions: 4 }, (entries) => count += entries.length);
+      db.close();
+      count.should.equal(1000);
+    });
+  });
+  describe('close after writing', function() {
+    this.timeout(10000);
+    it('can close the database as soon as a write resolves', async function() {
+      // with separate flushed events, the committed and flushed events of a batch can be delivered together, and
+      // the close runs between them
+      let db = open(testDirPath + '/test-close-write.mdb', { overlappingSync: true, separateFlushed: true });
+      let puts = [];
+      for (let i = 0; i < 100; i++)
+        puts.push(db.put(i, 'value ' + i));
+      await Promise.all(puts);
+      db.close();
+    });
+  });
   describe('ArrayLikeIterable', function() {
     it('concat and iterate', async function() {
       let a = new ArrayLikeIterable([1, 2, 3])
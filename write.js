@@ -1,5 +1,6 @@
 import { getAddressShared as getAddress } from './native.js';
 import { when } from './util/when.js';
+import { trainFromSamples, encodeDictionaries, decodeDictionaries } from './dictionary.js';
 var backpressureArray;
 
 const WAITING_OPERATION = 0x2000000;
@@ -10,6 +11,25 @@ const TXN_FLUSHED = 0x20000000;
 const TXN_FAILED = 0x40000000;
 const FAILED_CONDITION = 0x4000000;
 const REUSE_BUFFER_MODE = 1000;
+const HAS_INLINE_VALUE = 0x400;
+const MAX_FREE_SEGMENTS = 16;
+const MAX_FREE_RESOLUTIONS = 0x4000;
+const DEFER_WRITE = {}; // return a function to finish the write later, for batch starts
+const MAX_INLINE_VALUE = 384; // values up to this size are copied into the instruction buffer instead of referenced
+const DELETE_RANGE = 7;
+// merge operators, applied by the write thread to the current value
+const MERGE_OPERATOR_SHIFT = 21;
+const MERGE_ADD = 1;
+const MERGE_MAX = 2;
+const MERGE_MIN = 3;
+const MERGE_APPEND = 4;
+const MERGE_PATCH = 5;
+const MERGE_REPLACE = 6;
+const MERGE_FLOAT = 0x800;
+const SUPERSEDED = 0x1000;
+// the flags a plain put or delete can carry and still be replaced by a later write to the same key
+const COALESCING_MASK = ~(0x200 | HAS_INLINE_VALUE | 0x100000);
+const EMPTY_KEY = typeof Buffer != 'undefined' ? Buffer.alloc(0) : new Uint8Array(0);
 export const binaryBuffer = Symbol('binaryBuffer');
 
 const SYNC_PROMISE_SUCCESS = Promise.resolve(true);
@@ -21,23 +41,47 @@ SYNC_PROMISE_FAIL.isSync = true;
 const ByteArray = typeof Buffer != 'undefined' ? Buffer.from : Uint8Array;
 //let debugLog = []
 const WRITE_BUFFER_SIZE = 0x10000;
+// the last word of each instruction buffer counts the compression jobs queued for it, it isn't reused until they are done
+const COMPRESSION_JOBS = (WRITE_BUFFER_SIZE >> 2) - 2;
 var log = [];
-export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, useWritemap, maxKeySize,
-	eventTurnBatching, txnStartThreshold, batchStartThreshold, overlappingSync, commitDelay, separateFlushed }) {
+export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, getLastVersion, useWritemap, maxKeySize,
+	eventTurnBatching, txnStartThreshold, batchStartThreshold, overlappingSync, commitDelay, separateFlushed, coalesceWrites }) {
 	//  stands for write instructions
 	var dynamicBytes;
+	// instruction buffers in the order they were filled, and the ones that the write thread is done with, to reuse
+	var activeSegments = [], freeSegments = [];
 	function allocateInstructionBuffer() {
-		let buffer = new SharedArrayBuffer(WRITE_BUFFER_SIZE); // Must use a shared buffer to ensure GC doesn't move it around
-		dynamicBytes = new ByteArray(buffer);
-		let uint32 = dynamicBytes.uint32 = new Uint32Array(buffer, 0, WRITE_BUFFER_SIZE >> 2);
-		uint32[0] = 0;
-		dynamicBytes.float64 = new Float64Array(buffer, 0, WRITE_BUFFER_SIZE >> 3);
-		buffer.address = getAddress(buffer);
-		uint32.address = buffer.address + uint32.byteOffset;
+		dynamicBytes = freeSegments.pop();
+		if (dynamicBytes) {
+			dynamicBytes.uint32.fill(0); // the write thread waits on zeroed words for the next instruction
+		} else {
+			let buffer = new SharedArrayBuffer(WRITE_BUFFER_SIZE); // Must use a shared buffer to ensure GC doesn't move it around
+			dynamicBytes = new ByteArray(buffer);
+			let uint32 = dynamicBytes.uint32 = new Uint32Array(buffer, 0, WRITE_BUFFER_SIZE >> 2);
+			uint32[0] = 0;
+			dynamicBytes.float64 = new Float64Array(buffer, 0, WRITE_BUFFER_SIZE >> 3);
+			buffer.address = getAddress(buffer);
+			uint32.address = buffer.address + uint32.byteOffset;
+		}
 		dynamicBytes.position = 0;
+		activeSegments.push(dynamicBytes);
 		return dynamicBytes;
 	}
-	var newBufferThreshold = (WRITE_BUFFER_SIZE - maxKeySize - 64) >> 3; // need to reserve more room if we do inline values
+	function recycleInstructionBuffers(runningBatch) {
+		// a committed transaction delimiter is the start of the batch the write thread is now running, so buffers before
+		// it and before the first unfinished instruction are no longer touched by the write thread and can be reused (once
+		// the compression threads have popped all their jobs for it)
+		let unwritten = unwrittenResolution.uint32;
+		let segment;
+		while ((segment = activeSegments[0]) !== dynamicBytes && segment.uint32 !== unwritten && segment.uint32 !== runningBatch &&
+				Atomics.load(segment.uint32, COMPRESSION_JOBS) == 0) {
+			activeSegments.shift();
+			if (freeSegments.length < MAX_FREE_SEGMENTS)
+				freeSegments.push(segment);
+		}
+	}
+	// reserve room for a key and inline value, and the compression job count at the end
+	var newBufferThreshold = (WRITE_BUFFER_SIZE - maxKeySize - MAX_INLINE_VALUE - 72) >> 3;
 	var outstandingWriteCount = 0;
 	var startAddress = 0;
 	var writeTxn = null;
@@ -49,6 +93,7 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 	var enqueuedCommit;
 	var afterCommitCallbacks = [];
 	var beforeCommitCallbacks = [];
+	var slowReaderCallbacks = [];
 	var enqueuedEventTurnBatch;
 	var batchDepth = 0;
 	var writeBatchStart, outstandingBatchCount;
@@ -57,13 +102,19 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 
 	allocateInstructionBuffer();
 	dynamicBytes.uint32[0] = TXN_DELIMITER | TXN_COMMITTED | TXN_FLUSHED;
-	var txnResolution, lastQueuedResolution, nextResolution = { uint32: dynamicBytes.uint32, flagPosition: 0, };
-	var uncommittedResolution = { next: nextResolution };
+	var freeResolutions = [];
+	var txnResolution, lastQueuedResolution, nextResolution = newResolution(dynamicBytes.uint32, 0);
+	var uncommittedResolution = newResolution(null, 0);
+	uncommittedResolution.next = nextResolution;
 	var unwrittenResolution = nextResolution;
-	function writeInstructions(flags, store, key, value, version, ifVersion) {
-		let writeStatus;
+	var oldestResolution = uncommittedResolution;
+	// the last plain put/delete of each key (per dbi) in the event turn batch whose start hasn't been written yet
+	var coalescingBatch, coalescingKeys = [];
+	function writeInstructions(flags, store, key, value, version, ifVersion, callback) {
 		let targetBytes, position;
-		let valueBuffer, valueSize, valueBufferStart;
+		let valueBuffer, valueSize, valueBufferStart, valueString;
+		let resultPosition = 0; // the value slot that the previous value of a get-and-set is returned in
+		let coalescingKey;
 		if (flags & 2) {
 			// encode first in case we have to write a shared structure
 			let encoder = store.encoder;
@@ -74,20 +125,32 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 					valueBuffer = encoder.encode(value, REUSE_BUFFER_MODE);
 				else { // various other encoders, including JSON.stringify, that might serialize to a string
 					valueBuffer = encoder.encode(value);
-					if (typeof valueBuffer == 'string')
-						valueBuffer = Buffer.from(valueBuffer); // TODO: Would be nice to write strings inline in the instructions
+					if (typeof valueBuffer == 'string') {
+						valueString = valueBuffer;
+						valueBuffer = null;
+					}
 				}
 			} else if (typeof value == 'string') {
-				valueBuffer = Buffer.from(value); // TODO: Would be nice to write strings inline in the instructions
+				valueString = value;
 			} else if (value instanceof Uint8Array)
 				valueBuffer = value;
 			else
 				throw new Error('Invalid value to put in database ' + value + ' (' + (typeof value) +'), consider using encoder');
-			valueBufferStart = valueBuffer.start;
-			if (valueBufferStart > -1) // if we have buffers with start/end position
-				valueSize = valueBuffer.end - valueBufferStart; // size
-			else
-				valueSize = valueBuffer.length;
+			if (valueString !== undefined) {
+				// short strings are written directly into the instructions, longer ones need their own buffer
+				if (valueString.length * 3 > MAX_INLINE_VALUE) {
+					valueBuffer = Buffer.from(valueString);
+					valueString = undefined;
+				} else
+					valueSize = valueString.length; // until it is written and we know the byte length
+			}
+			if (valueBuffer) {
+				valueBufferStart = valueBuffer.start;
+				if (valueBufferStart > -1) // if we have buffers with start/end position
+					valueSize = valueBuffer.end - valueBufferStart; // size
+				else
+					valueSize = valueBuffer.length;
+			}
 			if (store.dupSort && valueSize > maxKeySize)
 				throw new Error('The value is larger than the maximum size (' + maxKeySize + ') for a value in a dupSort database');
 		} else
@@ -113,7 +176,7 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 				});
 				commitPromise = null; // reset the commit promise, can't know if it is really a new transaction prior to finishWrite being called
 				flushPromise = null;
-				writeBatchStart = writeInstructions(1, store);
+				writeBatchStart = writeInstructions(1, store, undefined, undefined, undefined, undefined, DEFER_WRITE);
 				outstandingBatchCount = 0;
 				batchDepth++;
 			}
@@ -132,7 +195,9 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 			let keyStartPosition = (position << 3) + 12;
 			let endPosition;
 			try {
-				endPosition = store.writeKey(key, targetBytes, keyStartPosition);
+				// a range delete with no start key is written with an empty key
+				endPosition = key === undefined && (flags & 0xf) == DELETE_RANGE ? keyStartPosition :
+					store.writeKey(key, targetBytes, keyStartPosition);
 			} catch(error) {
 				targetBytes.fill(0, keyStartPosition);
 				if (error.name == 'RangeError')
@@ -145,31 +210,56 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 				throw new Error('Key size is larger than the maximum key size (' + maxKeySize + ')');
 			}
 			uint32[flagPosition + 2] = keySize;
+			if (coalesceWrites && writeBatchStart && batchDepth == 1 && !store.dupSort)
+				coalescingKey = targetBytes.toString('latin1', keyStartPosition, endPosition);
 			position = (endPosition + 16) >> 3;
 			if (flags & 2) {
-				let mustCompress;
-				if (valueBufferStart > -1) { // if we have buffers with start/end position
-					// record pointer to value buffer
-					float64[position] = (valueBuffer.address ||
-						(valueBuffer.address = getAddress(valueBuffer.buffer) + valueBuffer.byteOffset)) + valueBufferStart;
-					mustCompress = valueBuffer[valueBufferStart] >= 250; // this is the compression indicator, so we must compress
+				// a first byte of 250 or more is the compression indicator, so the value must be compressed
+				// (the size of a string that hasn't been written yet is its length, its byte length can be up to 3 times that)
+				let compress = store.compression && (valueSize >= store.compression.threshold ||
+					valueString !== undefined && valueSize * 3 >= store.compression.threshold &&
+						Buffer.byteLength(valueString) >= store.compression.threshold ||
+					valueBuffer && valueBuffer[valueBufferStart > -1 ? valueBufferStart : 0] >= 250) &&
+					(flags & 0xf) != DELETE_RANGE; // the end key of a range delete is never compressed
+				if (!compress && valueSize <= MAX_INLINE_VALUE && (flags >> MERGE_OPERATOR_SHIFT & 7) != MERGE_REPLACE &&
+						(position << 3) + MAX_INLINE_VALUE + 32 <= targetBytes.length) {
+					// small values are copied into the instructions after their size, so the write thread reads them in
+					// place and the value buffer doesn't need to be kept alive until it is written
+					flags |= HAS_INLINE_VALUE;
+					if (valueString !== undefined)
+						valueSize = targetBytes.write(valueString, position << 3);
+					else
+						targetBytes.set(valueBufferStart > -1 ?
+							valueBuffer.subarray(valueBufferStart, valueBufferStart + valueSize) : valueBuffer, position << 3);
+					uint32[(position << 1) - 1] = valueSize;
+					position += (valueSize + 7) >> 3;
+					valueBuffer = null;
 				} else {
-					let valueArrayBuffer = valueBuffer.buffer;
-					// record pointer to value buffer
-					float64[position] = (valueArrayBuffer.address ||
-						(valueArrayBuffer.address = getAddress(valueArrayBuffer))) + valueBuffer.byteOffset;
-					mustCompress = valueBuffer[0] >= 250; // this is the compression indicator, so we must compress
-				}
-				uint32[(position++ << 1) - 1] = valueSize;
-				if (store.compression && (valueSize >= store.compression.threshold || mustCompress)) {
-					flags |= 0x100000;
-					float64[position] = store.compression.address;
-					if (!writeTxn)
-						env.compress(uint32.address + (position << 3), () => {
-							// this is never actually called, just use to pin the buffer in memory until it is finished
-							console.log(float64);
-						});
-					position++;
+					if (valueString !== undefined) { // compressed, or no room left in the fixed buffer of a synchronous transaction
+						valueBuffer = Buffer.from(valueString);
+						valueSize = valueBuffer.length;
+					}
+					if (valueBufferStart > -1) { // if we have buffers with start/end position
+						// record pointer to value buffer
+						float64[position] = (valueBuffer.address ||
+							(valueBuffer.address = getAddress(valueBuffer.buffer) + valueBuffer.byteOffset)) + valueBufferStart;
+					} else {
+						let valueArrayBuffer = valueBuffer.buffer;
+						// record pointer to value buffer
+						float64[position] = (valueArrayBuffer.address ||
+							(valueArrayBuffer.address = getAddress(valueArrayBuffer))) + valueBuffer.byteOffset;
+					}
+					if ((flags >> MERGE_OPERATOR_SHIFT & 7) == MERGE_REPLACE)
+						resultPosition = position;
+					uint32[(position++ << 1) - 1] = valueSize;
+					if (compress) {
+						flags |= 0x100000;
+						float64[position] = store.compression.address;
+						if (!writeTxn)
+							// queue it for the compression threads
+						env.compress(uint32.address + (position << 3), uint32.address + (COMPRESSION_JOBS << 2));
+						position++;
+					}
 				}
 			}
 			if (ifVersion !== undefined) {
@@ -190,7 +280,10 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 		if (writeTxn) {
 			uint32[0] = flags;
 			env.write(uint32.address);
-			return () => (uint32[0] & FAILED_CONDITION) ? SYNC_PROMISE_FAIL : SYNC_PROMISE_SUCCESS;
+			if (resultPosition)
+				return Promise.resolve((uint32[0] & FAILED_CONDITION) ? null :
+					env.takeWriteResult(uint32.address + (resultPosition << 3)));
+			return (uint32[0] & FAILED_CONDITION) ? SYNC_PROMISE_FAIL : SYNC_PROMISE_SUCCESS;
 		}
 		// if we ever use buffers that haven't been zero'ed, need to clear out the next slot like this:
 		// uint32[position << 1] = 0 // clear out the next slot
@@ -206,114 +299,176 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 		} else
 			nextUint32 = uint32;
 		let resolution = nextResolution;
-		// create the placeholder next resolution
-		nextResolution = resolution.next = store.cache ?
-		{
-			uint32: nextUint32,
-			flagPosition: position << 1,
-			flag: 0, // TODO: eventually eliminate this, as we can probably signify success by zeroing the flagPosition
-			valueBuffer: fixedBuffer, // these are all just placeholders so that we have the right hidden class initially allocated
-			next: null,
-			key,
-			store,
-			valueSize,
-		} :
-		{
-			uint32: nextUint32,
-			flagPosition: position << 1,
-			flag: 0, // TODO: eventually eliminate this, as we can probably signify success by zeroing the flagPosition
-			valueBuffer: fixedBuffer, // these are all just placeholders so that we have the right hidden class initially allocated
-			next: null,
-		};
-		let writtenBatchDepth = batchDepth;
-
-		return (callback) => {
-			if (writtenBatchDepth) {
-				// if we are in a batch, the transaction can't close, so we do the faster,
-				// but non-deterministic updates, knowing that the write thread can
-				// just poll for the status change if we miss a status update
-				writeStatus = uint32[flagPosition];
-				uint32[flagPosition] = flags;
-				//writeStatus = Atomics.or(uint32, flagPosition, flags)
-				if (writeBatchStart && !writeStatus) {
-					outstandingBatchCount += 1 + (valueSize >> 12);
-					if (outstandingBatchCount > batchStartThreshold) {
-						outstandingBatchCount = 0;
-						writeBatchStart();
-						writeBatchStart = null;
-					}
-				}
-			} else // otherwise the transaction could end at any time and we need to know the
-				// deterministically if it is ending, so we can reset the commit promise
-				// so we use the slower atomic operation
-				writeStatus = Atomics.or(uint32, flagPosition, flags);
-	
-			outstandingWriteCount++;
-			if (writeStatus & TXN_DELIMITER) {
-				commitPromise = null; // TODO: Don't reset these if this comes from the batch start operation on an event turn batch
-				flushPromise = null;
-				queueCommitResolution(resolution);
-				if (!startAddress) {
-					startAddress = uint32.address + (flagPosition << 2);
+		// the placeholder for the next instruction
+		nextResolution = resolution.next = newResolution(nextUint32, position << 1);
+		if (coalesceWrites)
+			coalesceWrite(resolution, flags, store.db.dbi, coalescingKey, ifVersion);
+		if (callback === DEFER_WRITE) { // the start of a batch is written once the operations in the batch have been queued
+			let writtenBatchDepth = batchDepth;
+			return (callback) => finishWrite(resolution, uint32, flagPosition, flags, writtenBatchDepth, store, key,
+				valueBuffer, valueSize, resultPosition, ifVersion, callback);
+		}
+		return finishWrite(resolution, uint32, flagPosition, flags, batchDepth, store, key, valueBuffer,
+			valueSize, resultPosition, ifVersion, callback);
+	}
+	function coalesceWrite(resolution, flags, dbi, key, ifVersion) {
+		if (coalescingBatch !== writeBatchStart) {
+			coalescingBatch = writeBatchStart;
+			coalescingKeys = [];
+		}
+		// the write thread can't see the instructions of the batch until its start is written, so an earlier
+		// write to the same key can still be marked as superseded (and it will be finished without being applied)
+		if (key !== undefined && ifVersion === undefined &&
+				((flags & COALESCING_MASK) == 15 || (flags & COALESCING_MASK) == 13)) {
+			let keys = coalescingKeys[dbi] || (coalescingKeys[dbi] = new Map());
+			let previous = keys.get(key);
+			if (previous)
+				previous.uint32[previous.flagPosition] |= SUPERSEDED;
+			keys.set(key, resolution);
+		} else if (writeBatchStart && batchDepth == 1) {
+			// anything else (conditions, callbacks, merges, range deletes) may depend on the earlier writes
+			coalescingKeys = [];
+		}
+	}
+	function finishWrite(resolution, uint32, flagPosition, flags, writtenBatchDepth, store, key, valueBuffer, valueSize,
+			resultPosition, ifVersion, callback) {
+		let writeStatus;
+		if (writtenBatchDepth) {
+			// if we are in a batch, the transaction can't close, so we do the faster,
+			// but non-deterministic updates, knowing that the write thread can
+			// just poll for the status change if we miss a status update
+			writeStatus = uint32[flagPosition];
+			uint32[flagPosition] = flags;
+			//writeStatus = Atomics.or(uint32, flagPosition, flags)
+			if (writeBatchStart && !writeStatus) {
+				outstandingBatchCount += 1 + (valueSize >> 12);
+				if (outstandingBatchCount > batchStartThreshold) {
+					outstandingBatchCount = 0;
+					writeBatchStart();
+					writeBatchStart = null;
 				}
 			}
-			if (!flushPromise && overlappingSync && separateFlushed)
-				flushPromise = new Promise(resolve => flushResolvers.push(resolve));
-			if (writeStatus & WAITING_OPERATION) { // write thread is waiting
-				env.write(0);
-			}
-			if (outstandingWriteCount > BACKPRESSURE_THRESHOLD) {
-				if (!backpressureArray)
-					backpressureArray = new Int32Array(new SharedArrayBuffer(4), 0, 1);
-				Atomics.wait(backpressureArray, 0, 0, Math.round(outstandingWriteCount / BACKPRESSURE_THRESHOLD));
-			}
-			if (startAddress) {
-				if (eventTurnBatching)
-					startWriting(); // start writing immediately because this has already been batched/queued
-				else if (!enqueuedCommit && txnStartThreshold) {
-					enqueuedCommit = commitDelay == 0 ? setImmediate(() => startWriting()) : setTimeout(() => startWriting(), commitDelay);
-				} else if (outstandingWriteCount > txnStartThreshold)
-					startWriting();
+		} else // otherwise the transaction could end at any time and we need to know the
+			// deterministically if it is ending, so we can reset the commit promise
+			// so we use the slower atomic operation
+			writeStatus = Atomics.or(uint32, flagPosition, flags);
+
+		outstandingWriteCount++;
+		if (writeStatus & TXN_DELIMITER) {
+			commitPromise = null; // TODO: Don't reset these if this comes from the batch start operation on an event turn batch
+			flushPromise = null;
+			queueCommitResolution(resolution);
+			if (!startAddress) {
+				startAddress = uint32.address + (flagPosition << 2);
 			}
+		}
+		if (!flushPromise && overlappingSync && separateFlushed)
+			flushPromise = new Promise(resolve => flushResolvers.push(resolve));
+		if (writeStatus & WAITING_OPERATION) { // write thread is waiting
+			env.write(0);
+		}
+		if (outstandingWriteCount > BACKPRESSURE_THRESHOLD) {
+			if (!backpressureArray)
+				backpressureArray = new Int32Array(new SharedArrayBuffer(4), 0, 1);
+			Atomics.wait(backpressureArray, 0, 0, Math.round(outstandingWriteCount / BACKPRESSURE_THRESHOLD));
+		}
+		if (startAddress) {
+			if (eventTurnBatching)
+				startWriting(); // start writing immediately because this has already been batched/queued
+			else if (!enqueuedCommit && txnStartThreshold) {
+				enqueuedCommit = commitDelay == 0 ? setImmediate(() => startWriting()) : setTimeout(() => startWriting(), commitDelay);
+			} else if (outstandingWriteCount > txnStartThreshold)
+				startWriting();
+		}
 
-			if ((outstandingWriteCount & 7) === 0)
-				resolveWrites();
-			
-			if (store.cache) {
-				resolution.key = key;
-				resolution.store = store;
-				resolution.valueSize = valueBuffer ? valueBuffer.length : 0;
-			}
-			resolution.valueBuffer = valueBuffer;
-			lastQueuedResolution = resolution;
+		if ((outstandingWriteCount & 7) === 0)
+			resolveWrites();
+		
+		if (store.cache) {
+			resolution.key = key;
+			resolution.store = store;
+			resolution.valueSize = valueSize;
+		}
+		resolution.valueBuffer = valueBuffer;
+		resolution.result = resultPosition;
+		lastQueuedResolution = resolution;
 
-			if (callback) {
-				resolution.reject = callback;
-				resolution.resolve = (value) => callback(null, value);
-				return;
-			}
-			if (ifVersion === undefined) {
-				if (writtenBatchDepth > 1)
-					return SYNC_PROMISE_SUCCESS; // or return undefined?
-				if (!commitPromise) {
-					commitPromise = new Promise((resolve, reject) => {
-						resolution.resolve = resolve;
-						resolution.reject = reject;
-					});
-					if (separateFlushed)
-						commitPromise.flushed = overlappingSync ? flushPromise : commitPromise;
-				}
-				return commitPromise;
+		if (callback) {
+			resolution.reject = callback;
+			resolution.resolve = (value) => callback(null, value);
+			return;
+		}
+		// writes share the promise for the commit of their transaction, unless they need their own result
+		if (ifVersion === undefined && !resultPosition) {
+			if (writtenBatchDepth > 1)
+				return SYNC_PROMISE_SUCCESS; // or return undefined?
+			if (!commitPromise) {
+				commitPromise = new Promise((resolve, reject) => {
+					resolution.resolve = resolve;
+					resolution.reject = reject;
+				});
+				if (separateFlushed)
+					commitPromise.flushed = overlappingSync ? flushPromise : commitPromise;
 			}
-			let promise = new Promise((resolve, reject) => {
-				resolution.resolve = resolve;
-				resolution.reject = reject;
-			});
-			if (separateFlushed)
-				promise.flushed = overlappingSync ? flushPromise : promise;
-			return promise;
+			return commitPromise;
+		}
+		let promise = new Promise((resolve, reject) => {
+			resolution.resolve = resolve;
+			resolution.reject = reject;
+		});
+		if (separateFlushed)
+			promise.flushed = overlappingSync ? flushPromise : promise;
+		return promise;
+	}
+	function newResolution(uint32, flagPosition) {
+		let resolution = freeResolutions.pop();
+		if (resolution) {
+			resolution.uint32 = uint32;
+			resolution.flagPosition = flagPosition;
+			return resolution;
+		}
+		// all resolutions have the same shape, so they can be reused for any write
+		return {
+			uint32,
+			flagPosition,
+			flag: 0, // TODO: eventually eliminate this, as we can probably signify success by zeroing the flagPosition
+			valueBuffer: null,
+			next: null,
+			result: 0,
+			key: undefined,
+			store: null,
+			valueSize: 0,
+			resolve: null,
+			reject: null,
+			isTxn: false,
+			nextTxn: null,
+			callbacks: null,
 		};
 	}
+	function recycleResolutions() {
+		// resolutions that have been finished, committed and resolved are not referenced anymore, and can be reused
+		let resolution;
+		while ((resolution = oldestResolution) !== uncommittedResolution && resolution !== unwrittenResolution &&
+				resolution !== lastQueuedResolution && resolution) {
+			oldestResolution = resolution.next;
+			if (freeResolutions.length < MAX_FREE_RESOLUTIONS) {
+				resolution.uint32 = null;
+				resolution.flag = 0;
+				resolution.valueBuffer = null;
+				resolution.next = null;
+				resolution.result = 0;
+				resolution.key = undefined;
+				resolution.store = null;
+				resolution.valueSize = 0;
+				resolution.resolve = null;
+				resolution.reject = null;
+				resolution.isTxn = false;
+				resolution.nextTxn = null;
+				resolution.callbacks = null;
+				freeResolutions.push(resolution);
+			}
+		}
+	}
 	function startWriting() {
 		if (enqueuedCommit) {
 			clearImmediate(enqueuedCommit);
@@ -367,6 +522,9 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 				nextTxnCallbacks.push(unwrittenResolution.callbacks);
 				unwrittenResolution.callbacks = null;
 			}
+			if (unwrittenResolution.result) // take the previous value of a get-and-set before the instructions are released
+				unwrittenResolution.result = (instructionStatus & FAILED_CONDITION) ? null :
+					env.takeWriteResult(unwrittenResolution.uint32.address + (unwrittenResolution.result << 3));
 			if (!unwrittenResolution.isTxn)
 				unwrittenResolution.uint32 = null;
 			unwrittenResolution.valueBuffer = null;
@@ -374,17 +532,36 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 			outstandingWriteCount--;
 			unwrittenResolution = unwrittenResolution.next;
 		}
+		let runningBatch;
 		while (txnResolution &&
 			(instructionStatus = txnResolution.uint32[txnResolution.flagPosition] & TXN_DONE)) {
+			runningBatch = txnResolution.uint32;
 			if (instructionStatus & TXN_FAILED)
 				rejectCommit();
 			else
 				resolveCommit(async);
 		}
+		if (runningBatch) {
+			recycleResolutions();
+			if (activeSegments.length > 1)
+				recycleInstructionBuffers(runningBatch);
+		}
 	}
 
+	// slow readers that were reported (with the notify slow reader policy) while committing
+	function notifySlowReaders() {
+		let readers = env.takeSlowReaders();
+		if (readers) {
+			for (let i = 0, l = readers.length; i < l; i++) {
+				for (let j = 0; j < slowReaderCallbacks.length; j++)
+					slowReaderCallbacks[j](readers[i]);
+			}
+		}
+	}
 	function resolveCommit(async) {
 		afterCommit();
+		if (slowReaderCallbacks.length > 0)
+			notifySlowReaders();
 		if (async)
 			resetReadTxn();
 		else
@@ -397,7 +574,7 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 				else if (flag & FAILED_CONDITION) {
 					uncommittedResolution.resolve(false);
 				} else
-					uncommittedResolution.resolve(true);
+					uncommittedResolution.resolve(uncommittedResolution.result === 0 ? true : uncommittedResolution.result);
 			}
 		} while((uncommittedResolution = uncommittedResolution.next) && uncommittedResolution != txnResolution)
 		txnResolution = txnResolution.nextTxn;
@@ -521,7 +698,7 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 			} else if (type == 'function') {
 				callback = versionOrOptions;
 			}
-			return writeInstructions(flags, this, key, value, this.useVersions ? versionOrOptions || 0 : undefined, ifVersion)(callback);
+			return writeInstructions(flags, this, key, value, this.useVersions ? versionOrOptions || 0 : undefined, ifVersion, callback);
 		},
 		remove(key, ifVersionOrValue, callback) {
 			let flags = 13;
@@ -536,7 +713,7 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 					value = ifVersionOrValue;
 				}
 			}
-			return writeInstructions(flags, this, key, value, undefined, ifVersion)(callback);
+			return writeInstructions(flags, this, key, value, undefined, ifVersion, callback);
 		},
 		del(key, options, callback) {
 			return this.remove(key, options, callback);
@@ -561,7 +738,7 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 				}
 				return SYNC_PROMISE_FAIL;
 			}
-			let finishStartWrite = writeInstructions(key === undefined || version === undefined ? 1 : 4, this, key, undefined, undefined, version);
+			let finishStartWrite = writeInstructions(key === undefined || version === undefined ? 1 : 4, this, key, undefined, undefined, version, DEFER_WRITE);
 			let promise;
 			batchDepth += 2;
 			if (batchDepth > 2)
@@ -597,13 +774,78 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 		batch(callbackOrOperations) {
 			return this.ifVersion(undefined, undefined, callbackOrOperations);
 		},
-		drop(callback) {
-			return writeInstructions(1024 + 12, this, undefined, undefined, undefined, undefined)(callback);
+		removeRange(options, callback) {
+			let { start, end, chunkSize } = options || {};
+			let endKey = EMPTY_KEY;
+			if (end !== undefined) {
+				endKey = Buffer.allocUnsafeSlow(maxKeySize + 8);
+				endKey = endKey.subarray(0, this.writeKey(end, endKey, 0));
+			}
+			// the end key is passed to the write thread like a value and the chunk size in the version slot
+			return writeInstructions(DELETE_RANGE, this, start, asBinary(endKey), chunkSize, undefined, callback);
+		},
+		add(key, amount, version) {
+			return this._merge(MERGE_ADD, key, amount, version);
+		},
+		max(key, number, version) {
+			return this._merge(MERGE_MAX, key, number, version);
+		},
+		min(key, number, version) {
+			return this._merge(MERGE_MIN, key, number, version);
+		},
+		append(key, bytes, version) {
+			return this._merge(MERGE_APPEND, key, bytes, version);
+		},
+		patch(key, offset, bytes, version) {
+			if (typeof bytes == 'string')
+				bytes = Buffer.from(bytes);
+			let operand = Buffer.allocUnsafe(bytes.length + 4);
+			operand.writeUInt32LE(offset, 0);
+			operand.set(bytes, 4);
+			return this._merge(MERGE_PATCH, key, operand, version);
+		},
+		getAndSet(key, value, version) {
+			return when(this._merge(MERGE_REPLACE, key, value, version), (previous) => {
+				if (!previous)
+					return;
+				if (this.decoder)
+					return this.decoder.decode(previous);
+				if (this.encoding == 'binary')
+					return previous;
+				previous = previous.toString();
+				return this.encoding == 'json' ? JSON.parse(previous) : previous;
+			});
+		},
+		_merge(operator, key, operand, version) {
+			// merges work on the raw stored bytes, which can't be compressed or be one of several values for a key
+			if (this.compression || this.dupSort)
+				throw new Error('Merge operators can not be used with compression or dupSort databases');
+			let flags = 15 | (operator << MERGE_OPERATOR_SHIFT);
+			if (operator <= MERGE_MIN) {
+				// numbers are stored as fixed width (8 byte) little-endian int64s (for bigints) or doubles
+				let number = Buffer.allocUnsafe(8);
+				if (typeof operand == 'bigint')
+					number.writeBigInt64LE(operand, 0);
+				else {
+					number.writeDoubleLE(operand, 0);
+					flags |= MERGE_FLOAT;
+				}
+				operand = asBinary(number);
+			} else if (operator != MERGE_REPLACE)
+				operand = asBinary(typeof operand == 'string' ? Buffer.from(operand) : operand);
+			return writeInstructions(flags, this, key, operand, this.useVersions ? version || 0 : undefined);
 		},
-		clearAsync(callback) {
+		drop(options, callback) {
+			if (typeof options == 'function')
+				callback = options;
+			return writeInstructions(1024 + 12, this, undefined, undefined, options && options.chunkSize, undefined, callback);
+		},
+		clearAsync(options, callback) {
+			if (typeof options == 'function')
+				callback = options;
 			if (this.encoder && this.encoder.structures)
 				this.encoder.structures = [];
-			return writeInstructions(12, this, undefined, undefined, undefined, undefined)(callback);
+			return writeInstructions(12, this, undefined, undefined, options && options.chunkSize, undefined, callback);
 		},
 		_triggerError() {
 			finishBatch();
@@ -661,7 +903,7 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 			if (!nextResolution.callbacks) {
 				txnCallbacks = [asChild ? { callback, asChild } : callback];
 				nextResolution.callbacks = txnCallbacks;
-				txnCallbacks.results = writeInstructions(8 | (this.strictAsyncOrder ? 0x100000 : 0), this)();
+				txnCallbacks.results = writeInstructions(8 | (this.strictAsyncOrder ? 0x100000 : 0), this);
 				txnIndex = 0;
 			} else {
 				txnCallbacks = lastQueuedResolution.callbacks;
@@ -697,6 +939,8 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 						else {
 							env.commitTxn();
 							resetReadTxn();
+							if (slowReaderCallbacks.length > 0)
+								notifySlowReaders();
 						}
 						return result;
 					} finally {
@@ -716,12 +960,75 @@ export function addWriteMethods(LMDBStore, { env, fixedBuffer, resetReadTxn, use
 		transactionSyncStart(callback) {
 			return this.transactionSync(callback, 0);
 		},
+		trainDictionary(options = {}) {
+			let compression = this.compression;
+			if (!compression || this.dictionaryKey === undefined)
+				throw new Error('Training a dictionary requires compression and a dictionaryKey');
+			// sample values evenly across the database, from those that are large enough to be compressed
+			let sampleCount = options.samples || 1000;
+			let stride = Math.max(1, Math.floor(this.getCount() / sampleCount));
+			let samples = [];
+			let i = 0;
+			for (let key of this.getKeys()) {
+				if (i++ % stride)
+					continue;
+				let value = this.getBinary(key);
+				if (value && value.length >= compression.threshold && samples.push(value) >= sampleCount)
+					break;
+			}
+			if (samples.length == 0)
+				throw new Error('There are no values large enough to be compressed to train a dictionary from');
+			let dictionary = trainFromSamples(samples, options.dictionarySize);
+			let version;
+			return when(this.transaction(() => {
+				let dictionaries = decodeDictionaries(this.dictionaryStore.getBinary(this.dictionaryKey));
+				version = dictionaries.reduce((max, entry) => Math.max(max, entry.version), 0) + 1;
+				if (version > 255)
+					throw new Error('The maximum number of dictionary versions has been reached');
+				dictionaries.push({ version, dictionary });
+				this.dictionaryStore.put(this.dictionaryKey, encodeDictionaries(dictionaries));
+			}), () => {
+				// only use the dictionary once it has been committed
+				this.loadDictionaries();
+				return version;
+			});
+		},
+		recompress(options = {}) {
+			let compression = this.compression;
+			if (!compression)
+				return Promise.resolve(0);
+			if (this.dupSort)
+				throw new Error('Recompression is not supported for dupSort databases');
+			let batchSize = Math.max(options.batchSize || 100, 2);
+			let recompressed = 0;
+			// each batch starts from the last key of the previous one, rechecking it is harmless since it is now current
+			const recompressFrom = (start) => {
+				let keys = Array.from(this.getKeys({ start, limit: batchSize, snapshot: false }));
+				// the codec and dictionary that values are compressed with now, in the form takeLastCompression returns
+				let current = (compression.codecId << 8) | (compression.dictionaryVersion || 0);
+				return when(this.transaction(() => {
+					compression.takeLastCompression();
+					for (let key of keys) {
+						let value = this.getBinary(key);
+						let lastCompression = compression.takeLastCompression();
+						if (value && lastCompression > -1 && lastCompression != current) {
+							// write the same bytes (and version), which are compressed with the current codec and dictionary
+							writeInstructions(15, this, key, asBinary(value), this.useVersions ? getLastVersion() : undefined);
+							recompressed++;
+						}
+					}
+				}), () => keys.length < batchSize ? recompressed : recompressFrom(keys[keys.length - 1]));
+			};
+			return recompressFrom(undefined);
+		},
 		on(event, callback) {
 			if (event == 'beforecommit') {
 				eventTurnBatching = true;
 				beforeCommitCallbacks.push(callback);
 			} else if (event == 'aftercommit')
 				afterCommitCallbacks.push(callback);
+			else if (event == 'slowreader')
+				slowReaderCallbacks.push(callback);
 		}
 	});
 	LMDBStore.prototype.del = LMDBStore.prototype.remove;